@@ -0,0 +1,88 @@
+// Round-trips VRInputEmulator::ping() between a client and the stub driver's ipc server running in the same process,
+// once over the shared memory channel and once over the message queues, and reports the round trip latency.
+//
+// Usage: ipc_pingpong_bench [options]
+//   --iterations <n>   pings per transport (default 100000)
+//   --warmup <n>       untimed pings before each run (default 1000)
+//
+// Exits with 1 when a transport fails, or when the shared memory channel is not used although it was requested.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <monotonic_clock.h>
+#include <vrinputemulator.h>
+#include "support/IpcDriverHost.h"
+#include "support/LatencySummary.h"
+
+using namespace vrinputemulator;
+
+
+// Returns false when the transport could not be used
+static bool runTransport(const char* name, bool sharedMemory, unsigned iterations, unsigned warmup)
+{
+	std::vector<int64_t> samples;
+	samples.reserve(iterations);
+	try
+	{
+		VRInputEmulator client;
+		client.setSharedMemoryTransportEnabled(sharedMemory);
+		client.connect();
+		if (client.isUsingSharedMemoryTransport() != sharedMemory)
+		{
+			std::fprintf(stderr, "%s: client is %susing the shared memory channel\n", name, sharedMemory ? "not " : "");
+			return false;
+		}
+		for (unsigned i = 0; i < warmup; i++)
+		{
+			client.ping();
+		}
+		for (unsigned i = 0; i < iterations; i++)
+		{
+			auto start = MonotonicClock::now();
+			client.ping();
+			samples.push_back(MonotonicClock::now() - start);
+		}
+		client.disconnect();
+	}
+	catch (std::exception& e)
+	{
+		std::fprintf(stderr, "%s: %s\n", name, e.what());
+		return false;
+	}
+	LatencySummary::of(samples).print(name);
+	return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+	unsigned iterations = 100000;
+	unsigned warmup = 1000;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--iterations" && hasValue)
+		{
+			iterations = (unsigned)std::atoi(argv[++i]);
+		}
+		else if (arg == "--warmup" && hasValue)
+		{
+			warmup = (unsigned)std::atoi(argv[++i]);
+		}
+		else
+		{
+			std::fprintf(stderr, "Usage: %s [--iterations <n>] [--warmup <n>]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	bench::startIpcDriver();
+	LatencySummary::printHeader("ping round trip");
+	bool ok = runTransport("shared memory", true, iterations, warmup);
+	ok = runTransport("message queue", false, iterations, warmup) && ok;
+	bench::stopIpcDriver();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+// Replays a pose recording (see pose_recording.h) through DeviceManipulationHandle::handlePoseUpdate once for every
+// motion compensation vel/acc mode and reports the per-call latency.
+//
+// Usage: pose_replay_bench [options] <recording>
+//        pose_replay_bench [options] --synthesize <file>
+//   --ref <id>            motion reference device (default 1)
+//   --synthesize <file>   write a synthetic recording (HMD at 1120 Hz, controllers at 369 Hz) to <file> and replay it
+//   --seconds <s>         length of the synthetic recording (default 10)
+//   --controllers <n>     controllers in the synthetic recording, the first one is the motion reference (default 2)
+//   --realtime            replay at the recorded pace instead of as fast as possible
+//   --budget <us>         per-call budget the p99.9 latency of every mode is checked against (default 166)
+//
+// Exits with 1 when a mode exceeds the budget.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <openvr_driver.h>
+#include <monotonic_clock.h>
+#include <pose_recording.h>
+#include "support/ServerDriverStub.h"
+#include "support/SyntheticPoseRecording.h"
+#include "support/LatencySummary.h"
+
+using namespace vrinputemulator;
+using namespace vrinputemulator::driver;
+
+
+static const struct
+{
+	MotionCompensationVelAccMode mode;
+	const char* name;
+} velAccModes[] = {
+	{ MotionCompensationVelAccMode::Disabled, "Disabled" },
+	{ MotionCompensationVelAccMode::SetZero, "SetZero" },
+	{ MotionCompensationVelAccMode::SubstractMotionRef, "SubstractMotionRef" },
+	{ MotionCompensationVelAccMode::LinearApproximation, "LinearApproximation" },
+	{ MotionCompensationVelAccMode::KalmanFilter, "KalmanFilter" },
+};
+
+static const int64_t runFrameInterval = 11000000; // nanoseconds, SteamVR calls RunFrame at about 90 Hz
+
+
+int main(int argc, char* argv[])
+{
+	std::string recordingFile;
+	std::string synthesizeFile;
+	SyntheticPoseRecordingParams synthetic;
+	uint32_t refDeviceId = 1;
+	bool realtime = false;
+	double budget = 166.0;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--ref" && hasValue)
+		{
+			refDeviceId = (uint32_t)std::atoi(argv[++i]);
+		}
+		else if (arg == "--synthesize" && hasValue)
+		{
+			synthesizeFile = argv[++i];
+		}
+		else if (arg == "--seconds" && hasValue)
+		{
+			synthetic.seconds = std::atof(argv[++i]);
+		}
+		else if (arg == "--controllers" && hasValue)
+		{
+			synthetic.controllers = (unsigned)std::atoi(argv[++i]);
+		}
+		else if (arg == "--realtime")
+		{
+			realtime = true;
+		}
+		else if (arg == "--budget" && hasValue)
+		{
+			budget = std::atof(argv[++i]);
+		}
+		else if (arg[0] != '-' && recordingFile.empty())
+		{
+			recordingFile = arg;
+		}
+		else
+		{
+			std::fprintf(stderr, "Usage: %s [--ref <id>] [--realtime] [--budget <us>] <recording> | --synthesize <file> [--seconds <s>] [--controllers <n>]\n", argv[0]);
+			return 2;
+		}
+	}
+	el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Enabled, "false");
+
+	PoseRecordingReader recording;
+	try
+	{
+		if (!synthesizeFile.empty())
+		{
+			writeSyntheticPoseRecording(synthesizeFile, synthetic);
+			recordingFile = synthesizeFile;
+		}
+		if (recordingFile.empty())
+		{
+			std::fprintf(stderr, "No recording given\n");
+			return 2;
+		}
+		recording.open(recordingFile);
+	}
+	catch (std::exception& e)
+	{
+		std::fprintf(stderr, "Could not open pose recording: %s\n", e.what());
+		return 2;
+	}
+	if (recording.size() == 0)
+	{
+		std::fprintf(stderr, "Pose recording %s is empty\n", recordingFile.c_str());
+		return 2;
+	}
+
+	ServerDriver driver;
+	DeviceManipulationHandle* handles[vr::k_unMaxTrackedDeviceCount] = {};
+	size_t posesPerDevice[vr::k_unMaxTrackedDeviceCount] = {};
+	for (auto& rec : recording)
+	{
+		if (rec.deviceId >= vr::k_unMaxTrackedDeviceCount)
+		{
+			continue;
+		}
+		if (!handles[rec.deviceId])
+		{
+			auto deviceClass = rec.deviceId == vr::k_unTrackedDeviceIndex_Hmd ? vr::TrackedDeviceClass_HMD : vr::TrackedDeviceClass_Controller;
+			handles[rec.deviceId] = stub::addDevice(driver, rec.deviceId, deviceClass, ("device" + std::to_string(rec.deviceId)).c_str());
+		}
+		posesPerDevice[rec.deviceId]++;
+	}
+	if (refDeviceId >= vr::k_unMaxTrackedDeviceCount || !handles[refDeviceId])
+	{
+		std::fprintf(stderr, "Motion reference device %u does not appear in the recording\n", refDeviceId);
+		return 2;
+	}
+	auto seconds = MonotonicClock::toSeconds(recording[recording.size() - 1].timestamp - recording[0].timestamp);
+	std::printf("%s: %zu poses over %.1f s, motion reference %u\n", recordingFile.c_str(), recording.size(), seconds, refDeviceId);
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; id++)
+	{
+		if (posesPerDevice[id])
+		{
+			std::printf("  device %u: %zu poses (%.0f Hz)\n", id, posesPerDevice[id], seconds > 0.0 ? posesPerDevice[id] / seconds : 0.0);
+		}
+	}
+	std::printf("\n");
+
+	bool withinBudget = true;
+	std::vector<int64_t> samples;
+	samples.reserve(recording.size());
+	LatencySummary::printHeader("vel/acc mode");
+	for (auto& m : velAccModes)
+	{
+		auto refHandle = handles[refDeviceId];
+		refHandle->setDefaultMode();
+		driver.motionCompensation().applyMotionCompensationConfig(m.mode, 0.1, 0.1, 10.0, 0.5, 3);
+		refHandle->setMotionCompensationMode();
+
+		samples.clear();
+		auto replayStart = MonotonicClock::now();
+		auto firstTimestamp = recording[0].timestamp;
+		auto nextRunFrame = firstTimestamp;
+		for (auto& rec : recording)
+		{
+			if (rec.deviceId >= vr::k_unMaxTrackedDeviceCount)
+			{
+				continue;
+			}
+			if (realtime)
+			{
+				while (MonotonicClock::now() - replayStart < rec.timestamp - firstTimestamp)
+				{
+				}
+			}
+			if (rec.timestamp >= nextRunFrame)
+			{
+				driver.RunFrame();
+				nextRunFrame += runFrameInterval;
+			}
+			uint32_t deviceId = rec.deviceId;
+			auto pose = rec.rawPose;
+			auto start = MonotonicClock::now();
+			handles[deviceId]->handlePoseUpdate(deviceId, pose, sizeof(vr::DriverPose_t));
+			samples.push_back(MonotonicClock::now() - start);
+		}
+		auto summary = LatencySummary::of(samples);
+		summary.print(m.name);
+		if (summary.p999 > budget)
+		{
+			withinBudget = false;
+		}
+	}
+	std::printf("\nbudget %.0f us per call (p99.9): %s\n", budget, withinBudget ? "ok" : "EXCEEDED");
+	return withinBudget ? 0 : 1;
+}
@@ -0,0 +1,49 @@
+#include "IpcDriverHost.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "ServerDriverStub.h"
+
+
+namespace vrinputemulator
+{
+	namespace bench
+	{
+		static std::unique_ptr<driver::ServerDriver> _driver;
+		static std::thread _runFrameThread;
+		static std::atomic<bool> _stop = { false };
+
+		void startIpcDriver()
+		{
+			el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Enabled, "false");
+			_driver.reset(new driver::ServerDriver());
+			_driver->Init(nullptr);
+			_stop = false;
+			_runFrameThread = std::thread([]()
+			{
+				while (!_stop)
+				{
+					_driver->RunFrame();
+					std::this_thread::sleep_for(std::chrono::milliseconds(11));
+				}
+			});
+		}
+
+		void stopIpcDriver()
+		{
+			_stop = true;
+			if (_runFrameThread.joinable())
+			{
+				_runFrameThread.join();
+			}
+			if (_driver)
+			{
+				_driver->Cleanup();
+				_driver.reset();
+			}
+		}
+
+	} // end namespace bench
+} // end namespace vrinputemulator
@@ -0,0 +1,15 @@
+#pragma once
+
+
+// Runs the stub ServerDriver's ipc server in the current process, for benchmarks that link the client library.
+// Kept out of the benchmark's translation unit: openvr_driver.h and the client's vrinputemulator.h cannot be included together.
+namespace vrinputemulator
+{
+	namespace bench
+	{
+		// Creates the driver, starts its ipc threads and calls RunFrame at about 90 Hz until stopIpcDriver()
+		void startIpcDriver();
+		void stopIpcDriver();
+
+	} // end namespace bench
+} // end namespace vrinputemulator
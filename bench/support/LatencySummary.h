@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+
+namespace vrinputemulator
+{
+	// Exact percentiles of a set of latency samples (nanoseconds), reported in microseconds
+	struct LatencySummary
+	{
+		size_t count = 0;
+		double p50 = 0.0;
+		double p99 = 0.0;
+		double p999 = 0.0;
+		double max = 0.0;
+
+		// Sorts the samples
+		static LatencySummary of(std::vector<int64_t>& samples)
+		{
+			LatencySummary s;
+			s.count = samples.size();
+			if (samples.empty())
+			{
+				return s;
+			}
+			std::sort(samples.begin(), samples.end());
+			auto at = [&samples](double q)
+			{
+				auto rank = (size_t)std::ceil(q * samples.size());
+				return (double)samples[std::min(samples.size(), std::max(rank, (size_t)1)) - 1] / 1000.0;
+			};
+			s.p50 = at(0.5);
+			s.p99 = at(0.99);
+			s.p999 = at(0.999);
+			s.max = (double)samples.back() / 1000.0;
+			return s;
+		}
+
+		static void printHeader(const char* label)
+		{
+			std::printf("%-24s %10s %10s %10s %10s %10s\n", label, "samples", "p50 [us]", "p99 [us]", "p99.9 [us]", "max [us]");
+		}
+
+		void print(const char* label) const
+		{
+			std::printf("%-24s %10zu %10.3f %10.3f %10.3f %10.3f\n", label, count, p50, p99, p999, max);
+		}
+	};
+
+} // end namespace vrinputemulator
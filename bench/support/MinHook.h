@@ -0,0 +1,17 @@
+#pragma once
+
+// Stand-in for third-party/MinHook/include/MinHook.h, which needs windows.h.
+// Nothing built by the benchmarks installs hooks, hooks/common.h only needs the declarations.
+
+typedef void* LPVOID;
+
+typedef enum MH_STATUS
+{
+	MH_UNKNOWN = -1,
+	MH_OK = 0
+} MH_STATUS;
+
+MH_STATUS MH_CreateHook(LPVOID pTarget, LPVOID pDetour, LPVOID* ppOriginal);
+MH_STATUS MH_RemoveHook(LPVOID pTarget);
+MH_STATUS MH_EnableHook(LPVOID pTarget);
+const char* MH_StatusToString(MH_STATUS status);
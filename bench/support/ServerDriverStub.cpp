@@ -0,0 +1,142 @@
+#include "ServerDriverStub.h"
+
+#include <atomic>
+#include "hooks/IVRServerDriverHost004Hooks.h"
+#include "hooks/IVRServerDriverHost005Hooks.h"
+
+
+// Implements the parts of ServerDriver (and of the hooks it installs) the pose and ipc paths call into.
+// There is no SteamVR: devices are added through stub::addDevice, poses forwarded to SteamVR are dropped,
+// and the ipc server only runs after Init() has been called.
+
+INITIALIZE_EASYLOGGINGPP // normally done by dllmain.cpp
+
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		static std::atomic<uint64_t> _publishedEventCount = { 0 };
+		static bool _ipcRunning = false;
+		static char _deviceDriverKeys[vr::k_unMaxTrackedDeviceCount]; // stands in for the device driver pointers handles are keyed by
+
+		ServerDriver* ServerDriver::singleton = nullptr;
+		std::string ServerDriver::installDir;
+
+
+		ServerDriver::ServerDriver() : m_motionCompensation(this)
+		{
+			singleton = this;
+			memset(_openvrIdToDeviceManipulationHandleMap, 0, sizeof(DeviceManipulationHandle*) * vr::k_unMaxTrackedDeviceCount);
+			memset(m_openvrIdToVirtualDeviceMap, 0, sizeof(VirtualDeviceDriver*) * vr::k_unMaxTrackedDeviceCount);
+		}
+
+		ServerDriver::~ServerDriver()
+		{
+			if (singleton == this)
+			{
+				singleton = nullptr;
+			}
+		}
+
+		vr::EVRInitError ServerDriver::Init(vr::IVRDriverContext* pDriverContext)
+		{
+			AsyncLogger::start();
+			shmCommunicator.init(this);
+			_ipcRunning = true;
+			return vr::VRInitError_None;
+		}
+
+		void ServerDriver::Cleanup()
+		{
+			if (_ipcRunning)
+			{
+				shmCommunicator.shutdown();
+				_ipcRunning = false;
+			}
+			AsyncLogger::stop();
+		}
+
+		void ServerDriver::RunFrame()
+		{
+			for (auto d : _deviceManipulationHandles)
+			{
+				d.second->RunFrame();
+			}
+			m_motionCompensation.runFrame();
+			if (_ipcRunning)
+			{
+				shmCommunicator.runFrame();
+			}
+		}
+
+		void ServerDriver::openvr_vendorSpecificEvent(uint32_t unWhichDevice, vr::EVREventType eventType, const vr::VREvent_Data_t& eventData, double eventTimeOffset)
+		{
+		}
+
+		DeviceManipulationHandle* ServerDriver::getDeviceManipulationHandleById(uint32_t unWhichDevice)
+		{
+			std::lock_guard<std::recursive_mutex> lock(_deviceManipulationHandlesMutex);
+			if (_openvrIdToDeviceManipulationHandleMap[unWhichDevice] && _openvrIdToDeviceManipulationHandleMap[unWhichDevice]->isValid())
+			{
+				return _openvrIdToDeviceManipulationHandleMap[unWhichDevice];
+			}
+			return nullptr;
+		}
+
+		void ServerDriver::sendReplySetMotionCompensationMode(uint32_t deviceId, bool success)
+		{
+			shmCommunicator.sendReplySetMotionCompensationMode(deviceId, success);
+		}
+
+		void ServerDriver::publishDriverEvent(const DriverEvent& event)
+		{
+			_publishedEventCount.fetch_add(1, std::memory_order_relaxed);
+			shmCommunicator.publishEvent(event);
+		}
+
+		void ServerDriver::hooksTrackedDeviceAdded(void* serverDriverHost, int version, const char* pchDeviceSerialNumber, vr::ETrackedDeviceClass& eDeviceClass, void* pDriver)
+		{
+			std::lock_guard<std::recursive_mutex> lock(_deviceManipulationHandlesMutex);
+			auto handle = std::make_shared<DeviceManipulationHandle>(pchDeviceSerialNumber, eDeviceClass, pDriver, serverDriverHost, version);
+			_deviceManipulationHandles.insert({ pDriver, handle });
+		}
+
+		void ServerDriver::hooksTrackedDeviceActivated(void* serverDriver, int version, uint32_t unObjectId)
+		{
+			std::lock_guard<std::recursive_mutex> lock(_deviceManipulationHandlesMutex);
+			auto i = _deviceManipulationHandles.find(serverDriver);
+			if (i != _deviceManipulationHandles.end())
+			{
+				i->second->setOpenvrId(unObjectId);
+				_openvrIdToDeviceManipulationHandleMap[unObjectId] = i->second.get();
+			}
+		}
+
+
+		void IVRServerDriverHost004Hooks::trackedDevicePoseUpdatedOrig(void* _this, uint32_t unWhichDevice, const vr::DriverPose_t& newPose, uint32_t unPoseStructSize)
+		{
+		}
+
+		void IVRServerDriverHost005Hooks::trackedDevicePoseUpdatedOrig(void* _this, uint32_t unWhichDevice, const vr::DriverPose_t& newPose, uint32_t unPoseStructSize)
+		{
+		}
+
+
+		namespace stub
+		{
+			DeviceManipulationHandle* addDevice(ServerDriver& driver, uint32_t openvrId, vr::ETrackedDeviceClass deviceClass, const char* serial)
+			{
+				void* key = &_deviceDriverKeys[openvrId];
+				driver.hooksTrackedDeviceAdded(nullptr, 5, serial, deviceClass, key);
+				driver.hooksTrackedDeviceActivated(key, 5, openvrId);
+				return driver.getDeviceManipulationHandleById(openvrId);
+			}
+
+			uint64_t publishedEventCount()
+			{
+				return _publishedEventCount.load(std::memory_order_relaxed);
+			}
+
+		} // end namespace stub
+	} // end namespace driver
+} // end namespace vrinputemulator
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <openvr_driver.h>
+#include "driver/ServerDriver.h"
+#include "devicemanipulation/DeviceManipulationHandle.h"
+
+
+// Stand-in for driver/ServerDriver.cpp, see ServerDriverStub.cpp
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		namespace stub
+		{
+			// Registers a device the way the hooks into a device driver would, returns its handle
+			DeviceManipulationHandle* addDevice(ServerDriver& driver, uint32_t openvrId, vr::ETrackedDeviceClass deviceClass, const char* serial);
+
+			// Number of driver events published so far (from any thread)
+			uint64_t publishedEventCount();
+
+		} // end namespace stub
+	} // end namespace driver
+} // end namespace vrinputemulator
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <stdint.h>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <openvr_driver.h>
+#include <openvr_math.h>
+#include <pose_recording.h>
+
+
+namespace vrinputemulator
+{
+	// Parameters of a generated pose recording, see writeSyntheticPoseRecording()
+	struct SyntheticPoseRecordingParams
+	{
+		double seconds = 10.0;
+		unsigned controllers = 2; // devices 1 .. controllers, device 1 is mounted on the motion platform (the motion reference)
+		double hmdRate = 1120.0; // Hz, IMU rate of a lighthouse HMD
+		double controllerRate = 369.0; // Hz, IMU rate of a lighthouse controller / tracker
+		double referenceDropoutInterval = 2.0; // seconds, the motion reference loses tracking this often ...
+		double referenceDropoutDuration = 0.05; // ... for this long
+		double poseTimeOffset = -0.005; // seconds
+		double poseTimeOffsetJitter = 0.0005; // seconds, makes sample times go backwards every now and then
+		uint32_t seed = 1;
+	};
+
+
+	// Writes a recording in the format of the driver's pose recorder (see pose_recording.h): an HMD (device 0) and a number
+	// of controllers sitting on a motion platform that pitches, rolls and heaves, the head and the hands moving on top of it.
+	// Throws std::runtime_error when the file cannot be written.
+	inline void writeSyntheticPoseRecording(const std::string& filename, const SyntheticPoseRecordingParams& params)
+	{
+		std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			throw std::runtime_error("Could not create " + filename);
+		}
+		PoseRecordingHeader header;
+		std::memcpy(header.magic, PoseRecordingMagic, sizeof(PoseRecordingMagic));
+		header.version = POSE_RECORDING_VERSION;
+		header.recordSize = sizeof(PoseRecord);
+		file.write((const char*)&header, sizeof(header));
+
+		std::mt19937 rng(params.seed);
+		std::uniform_real_distribution<double> jitter(-params.poseTimeOffsetJitter, params.poseTimeOffsetJitter);
+		auto worldFromDriverRotation = vrmath::quaternionFromRotationY(0.7);
+		const double worldFromDriverTranslation[3] = { 0.4, -0.1, 1.3 };
+
+		// platform (in app space) and the devices relative to it, t in seconds
+		auto platform = [](double t, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot)
+		{
+			pos = { 0.0, 0.05 * std::sin(2.0 * M_PI * 1.1 * t), 0.0 };
+			rot = vrmath::quaternionFromYawPitchRoll(0.0, 0.15 * std::sin(2.0 * M_PI * 0.7 * t), 0.12 * std::sin(2.0 * M_PI * 0.45 * t + 1.0));
+		};
+		auto device = [&platform](uint32_t id, double t, vr::HmdVector3d_t& pos, vr::HmdQuaternion_t& rot)
+		{
+			vr::HmdVector3d_t platformPos;
+			vr::HmdQuaternion_t platformRot;
+			platform(t, platformPos, platformRot);
+			vr::HmdVector3d_t localPos;
+			vr::HmdQuaternion_t localRot;
+			if (id == 0)
+			{ // head
+				localPos = { 0.05 * std::sin(2.0 * M_PI * 0.3 * t), 1.1, 0.03 * std::cos(2.0 * M_PI * 0.2 * t) };
+				localRot = vrmath::quaternionFromYawPitchRoll(0.4 * std::sin(2.0 * M_PI * 0.25 * t), 0.1 * std::sin(2.0 * M_PI * 0.4 * t), 0.0);
+			}
+			else if (id == 1)
+			{ // motion reference, fixed to the platform
+				localPos = { 0.0, 0.9, 0.3 };
+				localRot = { 1.0, 0.0, 0.0, 0.0 };
+			}
+			else
+			{ // hands
+				double phase = id * 0.9;
+				localPos = { (id % 2 ? -0.25 : 0.25) + 0.1 * std::sin(2.0 * M_PI * 0.8 * t + phase), 0.8 + 0.1 * std::sin(2.0 * M_PI * 0.6 * t + phase), -0.3 };
+				localRot = vrmath::quaternionFromYawPitchRoll(0.3 * std::sin(2.0 * M_PI * 0.5 * t + phase), 0.0, 0.2 * std::cos(2.0 * M_PI * 0.7 * t + phase));
+			}
+			pos = vrmath::quaternionRotateVector(platformRot, localPos) + platformPos;
+			rot = platformRot * localRot;
+		};
+
+		auto deviceCount = params.controllers + 1;
+		std::vector<double> period(deviceCount), next(deviceCount);
+		for (uint32_t id = 0; id < deviceCount; id++)
+		{
+			period[id] = 1.0 / (id == 0 ? params.hmdRate : params.controllerRate);
+			next[id] = period[id] * id / deviceCount; // devices do not report in lockstep
+		}
+		const int64_t start = 1000000000ll;
+		const double dt = 0.001; // for the finite differences
+		while (true)
+		{
+			uint32_t id = 0;
+			for (uint32_t i = 1; i < deviceCount; i++)
+			{
+				if (next[i] < next[id])
+				{
+					id = i;
+				}
+			}
+			double t = next[id];
+			if (t >= params.seconds)
+			{
+				break;
+			}
+			next[id] += period[id];
+
+			vr::HmdVector3d_t pos, pos2;
+			vr::HmdQuaternion_t rot, rot2;
+			device(id, t, pos, rot);
+			device(id, t + dt, pos2, rot2);
+			auto vel = (pos2 - pos) / dt;
+			// angular velocity from the rotation between the two samples (small angle: 2 * vector part of the difference)
+			auto diff = rot2 * vrmath::quaternionConjugate(rot);
+			vr::HmdVector3d_t angVel = { 2.0 * diff.x / dt, 2.0 * diff.y / dt, 2.0 * diff.z / dt };
+
+			PoseRecord rec = {};
+			rec.deviceId = id;
+			rec.forwarded = 1;
+			rec.timestamp = start + (int64_t)(t * 1e9);
+			auto& pose = rec.rawPose;
+			pose.poseTimeOffset = params.poseTimeOffset + jitter(rng);
+			pose.qWorldFromDriverRotation = worldFromDriverRotation;
+			std::memcpy(pose.vecWorldFromDriverTranslation, worldFromDriverTranslation, sizeof(worldFromDriverTranslation));
+			pose.qDriverFromHeadRotation = { 1.0, 0.0, 0.0, 0.0 };
+			// same conventions as MotionCompensationManager: app space = driver space rotated back by qWorldFromDriverRotation - vecWorldFromDriverTranslation
+			auto driverPos = vrmath::quaternionRotateVector(worldFromDriverRotation, pos + worldFromDriverTranslation);
+			auto driverVel = vrmath::quaternionRotateVector(worldFromDriverRotation, vel);
+			auto driverAngVel = vrmath::quaternionRotateVector(worldFromDriverRotation, angVel);
+			for (int i = 0; i < 3; i++)
+			{
+				pose.vecPosition[i] = driverPos.v[i];
+				pose.vecVelocity[i] = driverVel.v[i];
+				pose.vecAngularVelocity[i] = driverAngVel.v[i];
+			}
+			pose.qRotation = worldFromDriverRotation * rot;
+			bool dropout = id == 1 && params.referenceDropoutInterval > 0.0 && std::fmod(t, params.referenceDropoutInterval) > params.referenceDropoutInterval - params.referenceDropoutDuration;
+			pose.result = dropout ? vr::TrackingResult_Running_OutOfRange : vr::TrackingResult_Running_OK;
+			pose.poseIsValid = !dropout;
+			pose.deviceIsConnected = true;
+			rec.compensatedPose = pose;
+			file.write((const char*)&rec, sizeof(rec));
+		}
+		if (!file.flush())
+		{
+			throw std::runtime_error("Could not write " + filename);
+		}
+	}
+
+} // end namespace vrinputemulator
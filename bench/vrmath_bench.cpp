@@ -0,0 +1,102 @@
+// Microbenchmark of the openvr_math.h kernels used on the pose path.
+// The kernels are picked at compile time, so this is built once per code path (vrmath_bench_scalar, vrmath_bench_sse2,
+// vrmath_bench_avx), compare the ns/op columns of their outputs.
+//
+// Usage: vrmath_bench [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <openvr_driver.h>
+#include <openvr_math.h>
+
+#if defined(VRMATH_AVX)
+static const char* codePath = "AVX";
+#elif defined(VRMATH_SSE2)
+static const char* codePath = "SSE2";
+#else
+static const char* codePath = "scalar";
+#endif
+
+static const size_t dataSize = 1024; // fits into L1, measures the kernels and not the memory
+
+static double sink = 0.0;
+
+
+// Runs op(i) for i in [0, dataSize) iterations times and prints the time per call of op
+template<typename Op>
+static void run(const char* name, size_t iterations, size_t opsPerCall, Op op)
+{
+	for (size_t i = 0; i < dataSize; i++)
+	{ // warm up
+		op(i);
+	}
+	auto start = std::chrono::steady_clock::now();
+	for (size_t n = 0; n < iterations; n++)
+	{
+		for (size_t i = 0; i < dataSize; i++)
+		{
+			op(i);
+		}
+	}
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	double calls = (double)iterations * dataSize;
+	std::printf("%-8s %-40s %10.2f ns/call %10.2f ns/vector\n", codePath, name, elapsed.count() / calls, elapsed.count() / (calls * opsPerCall));
+}
+
+
+int main(int argc, char* argv[])
+{
+	size_t iterations = argc > 1 ? (size_t)std::atol(argv[1]) : 2000;
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> dist(-1.0, 1.0);
+	std::vector<vr::HmdQuaternion_t> quats(dataSize);
+	std::vector<vr::HmdVector3d_t> vecs(dataSize * 4), out(dataSize * 4);
+	for (auto& q : quats)
+	{
+		q = vrmath::quaternionFromYawPitchRoll(dist(rng), dist(rng), dist(rng));
+	}
+	for (auto& v : vecs)
+	{
+		v = { dist(rng), dist(rng), dist(rng) };
+	}
+
+	run("quaternion product", iterations, 1, [&](size_t i)
+	{
+		auto r = quats[i] * quats[(i + 1) % dataSize];
+		sink += r.w;
+	});
+	run("quaternion product (chained)", iterations, 1, [&](size_t i)
+	{ // rotDiffInv * (conjugate(qWorldFromDriverRotation) * qRotation), the product feeds the next one
+		auto r = quats[i] * (vrmath::quaternionConjugate(quats[(i + 1) % dataSize]) * quats[(i + 2) % dataSize]);
+		sink += r.w;
+	});
+	run("quaternionRotateVector",iterations, 1, [&](size_t i)
+	{
+		out[i] = vrmath::quaternionRotateVector(quats[i], vecs[i]);
+	});
+	run("quaternionRotateVector x4", iterations, 4, [&](size_t i)
+	{ // the SubstractMotionRef vel/acc block, one vector at a time
+		for (size_t k = 0; k < 4; k++)
+		{
+			out[i * 4 + k] = vrmath::quaternionRotateVector(quats[i], vecs[i * 4 + k]);
+		}
+	});
+	run("quaternionRotateVectors (batch of 4)", iterations, 4, [&](size_t i)
+	{ // the SubstractMotionRef vel/acc block
+		vrmath::quaternionRotateVectors(quats[i], &vecs[i * 4], &out[i * 4], 4);
+	});
+	auto m = vrmath::rotationMatrixFromQuaternion(quats[0]);
+	run("matMul33 (batch of 4)", iterations, 4, [&](size_t i)
+	{
+		vrmath::matMul33(m, &vecs[i * 4], &out[i * 4], 4);
+	});
+
+	for (auto& v : out)
+	{
+		sink += v.v[0];
+	}
+	return sink == 12345.0 ? 1 : 0; // keeps the results alive
+}
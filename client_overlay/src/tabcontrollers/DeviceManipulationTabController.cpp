@@ -12,6 +12,17 @@ namespace inputemulator
 {
 	DeviceManipulationTabController::~DeviceManipulationTabController()
 	{
+		if (driverEventsSubscribed)
+		{
+			try
+			{
+				parent->vrInputEmulator().subscribeDriverEvents(0, nullptr);
+			}
+			catch (std::exception& e)
+			{
+				LOG(ERROR) << "Could not unsubscribe from driver events: " << e.what();
+			}
+		}
 		if (identifyThread.joinable())
 		{
 			identifyThread.join();
@@ -73,19 +84,56 @@ namespace inputemulator
 		{
 			LOG(ERROR) << "Could not get device infos: " << e.what();
 		}
+		try
+		{
+			// the driver tells us about changes, so device infos only need to be queried when something happened
+			uint32_t eventMask = (uint32_t)vrinputemulator::DriverEventType::MotionCompensationStatusChanged
+				| (uint32_t)vrinputemulator::DriverEventType::DeviceModeChanged
+				| (uint32_t)vrinputemulator::DriverEventType::DeviceAdded;
+			parent->vrInputEmulator().subscribeDriverEvents(eventMask, [this](const vrinputemulator::DriverEvent&)
+															{
+																driverStateChanged = true;
+															});
+			driverEventsSubscribed = true;
+		}
+		catch (const std::exception & e)
+		{
+			LOG(ERROR) << "Could not subscribe to driver events, falling back to polling: " << e.what();
+		}
 	}
 
 	void DeviceManipulationTabController::eventLoopTick(vr::TrackedDevicePose_t* devicePoses)
 	{
-		if (settingsUpdateCounter >= 50)
+		if (settingsUpdateCounter >= 50 || driverStateChanged)
 		{
 			settingsUpdateCounter = 0;
 			if (parent->isDashboardVisible() || parent->isDesktopMode())
 			{
+				// one round trip for all devices instead of one per device, and only when the driver reported a change
+				vrinputemulator::AllDeviceInfos driverInfos;
+				if (driverStateChanged.exchange(false) || !driverEventsSubscribed)
+				{
+					try
+					{
+						parent->vrInputEmulator().getAllDeviceInfos(driverInfos);
+					}
+					catch (std::exception& e)
+					{
+						LOG(ERROR) << "Exception caught while getting device infos: " << e.what();
+					}
+				}
 				unsigned i = 0;
 				for (auto info : deviceInfos)
 				{
-					bool hasDeviceInfoChanged = updateDeviceInfo(i);
+					bool hasDeviceInfoChanged = false;
+					for (auto& driverInfo : driverInfos.devices)
+					{
+						if (driverInfo.deviceId == info->openvrId)
+						{
+							hasDeviceInfoChanged = _applyDeviceInfo(*info, driverInfo);
+							break;
+						}
+					}
 					unsigned status = devicePoses[info->openvrId].bDeviceIsConnected ? 0 : 1;
 					if (info->deviceMode == 0 && info->deviceStatus != status)
 					{
@@ -470,19 +518,16 @@ namespace inputemulator
 				parent->vrInputEmulator().setDeviceNormalMode(deviceInfos[index]->openvrId);
 				break;
 			case 1:
-				if (motionCompensationVelAccMode == vrinputemulator::MotionCompensationVelAccMode::KalmanFilter)
-				{
-					parent->vrInputEmulator().setMotionCompensationKalmanProcessNoise(motionCompensationKalmanProcessNoise);
-					parent->vrInputEmulator().setMotionCompensationKalmanObservationNoise(motionCompensationKalmanObservationNoise);
-					LOG(INFO) << "Set kalman mc mode";
-				}
-				else if (motionCompensationVelAccMode == vrinputemulator::MotionCompensationVelAccMode::LinearApproximation)
-				{
-					parent->vrInputEmulator().setMotionCompensationMovingAverageWindow(motionCompensationMovingAverageWindow);
-					LOG(INFO) << "Set moving avg mc mode";
-				}
-				parent->vrInputEmulator().setDeviceMotionCompensationMode(deviceInfos[index]->openvrId, motionCompensationVelAccMode);
-				break;
+			{
+				// filter settings and mode in one request, so the driver never runs with half of the new settings
+				vrinputemulator::MotionCompensationSettings settings;
+				settings.velAccMode = motionCompensationVelAccMode;
+				settings.kalmanProcessNoise = motionCompensationKalmanProcessNoise;
+				settings.kalmanObservationNoise = motionCompensationKalmanObservationNoise;
+				settings.movingAverageWindow = motionCompensationMovingAverageWindow;
+				parent->vrInputEmulator().applyMotionCompensation(deviceInfos[index]->openvrId, settings);
+				LOG(INFO) << "Set mc mode (vel/acc mode " << (int)motionCompensationVelAccMode << ")";
+			} break;
 			default:
 				retval = false;
 				m_deviceModeErrorString = "Unknown Device Mode";
@@ -544,21 +589,38 @@ namespace inputemulator
 
 	bool DeviceManipulationTabController::updateDeviceInfo(unsigned index)
 	{
-		/*bool retval = false;
-		if (index < deviceInfos.size()) {
-			try {
+		bool retval = false;
+		if (index < deviceInfos.size())
+		{
+			try
+			{
 				vrinputemulator::DeviceInfo info;
 				parent->vrInputEmulator().getDeviceInfo(deviceInfos[index]->openvrId, info);
-				if (deviceInfos[index]->deviceMode != info.deviceMode) {
-					deviceInfos[index]->deviceMode = info.deviceMode;
-					retval = true;
-				}
-			} catch (std::exception& e) {
+				retval = _applyDeviceInfo(*deviceInfos[index], info);
+			}
+			catch (std::exception& e)
+			{
 				LOG(ERROR) << "Exception caught while getting device info: " << e.what();
 			}
 		}
-		return retval;*/
-		return true;
+		return retval;
+	}
+
+	bool DeviceManipulationTabController::_applyDeviceInfo(DeviceInfo& info, const vrinputemulator::DeviceInfo& driverInfo)
+	{
+		bool retval = false;
+		int deviceMode = driverInfo.deviceMode == 5 ? 1 : 0; // the driver's motion compensation mode is 5, the overlay only knows default and motion compensation
+		if (info.deviceMode != deviceMode)
+		{
+			info.deviceMode = deviceMode;
+			retval = true;
+		}
+		if (info.refDeviceId != driverInfo.refDeviceId)
+		{
+			info.refDeviceId = driverInfo.refDeviceId;
+			retval = true;
+		}
+		return retval;
 	}
 
 	void DeviceManipulationTabController::setDeviceRenderModel(unsigned deviceIndex, unsigned renderModelIndex)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QObject>
+#include <atomic>
 #include <memory>
 #include <openvr.h>
 #include <vrinputemulator.h>
@@ -56,9 +57,13 @@ namespace inputemulator
 		QString m_deviceModeErrorString;
 
 		unsigned settingsUpdateCounter = 0;
+		bool driverEventsSubscribed = false;
+		std::atomic<bool> driverStateChanged = { true }; // set by driver events (ipc thread), consumed by eventLoopTick
 
 		std::thread identifyThread;
 
+		bool _applyDeviceInfo(DeviceInfo& info, const vrinputemulator::DeviceInfo& driverInfo);
+
 	public:
 		~DeviceManipulationTabController();
 		void initStage1();
@@ -1,9 +1,13 @@
 #include "driver_ipc_shm.h"
 
+#include <cstring>
+#include <vector>
+#include <algorithm>
 #include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <openvr_driver.h>
 #include <ipc_protocol.h>
 #include <openvr_math.h>
+#include <monotonic_clock.h>
 #include "../../driver/ServerDriver.h"
 #include "../../devicemanipulation/DeviceManipulationHandle.h"
 
@@ -16,276 +20,150 @@ namespace vrinputemulator
 		{
 			_driver = driver;
 			_ipcThreadStopFlag = false;
-			_ipcThread = std::thread(_ipcThreadFunc, this, driver);
+			try
+			{
+				// Create message queue (here and not in the thread, so shutdown() can always reach it)
+				boost::interprocess::message_queue::remove(_ipcQueueName.c_str());
+				_ipcQueue.reset(new boost::interprocess::message_queue(
+					boost::interprocess::create_only,
+					_ipcQueueName.c_str(),
+					100,					//max message number
+					ipc::MaxFrameSize    //max message size
+				));
+				_ipcThread = std::thread(_ipcThreadFunc, this, driver);
+			}
+			catch (std::exception & e)
+			{
+				_ipcQueue.reset();
+				LOG(ERROR) << "Could not create ipc server queue: " << e.what();
+			}
+			try
+			{
+				_shmDoorbell = ipc::ShmMapping<ipc::ShmDoorbellBlock>::create(_shmDoorbellName);
+				_shmThread = std::thread(_shmThreadFunc, this);
+			}
+			catch (std::exception & e)
+			{
+				_shmDoorbell.reset();
+				LOG(WARNING) << "Could not create shared memory doorbell, clients will use the message queue only: " << e.what();
+			}
 		}
 
 		void IpcShmCommunicator::shutdown()
 		{
-			if (_ipcThreadRunning)
+			_ipcThreadStopFlag = true;
+			if (_ipcThread.joinable())
 			{
-				_ipcThreadStopFlag = true;
+				// the receive loop blocks until a message arrives, so send it an empty one to make it see the stop flag
+				ipc::FrameWriter<ipc::Request> frame;
+				frame.append(ipc::Request(ipc::RequestType::None));
+				_ipcQueue->send(frame.data(), frame.size(), 0);
 				_ipcThread.join();
 			}
+			if (_ipcQueue)
+			{
+				_ipcQueue.reset();
+				boost::interprocess::message_queue::remove(_ipcQueueName.c_str());
+			}
+			if (_shmThread.joinable())
+			{
+				(*_shmDoorbell)->requestsAvailable.post(); // wake up the shared memory thread so it sees the stop flag
+				_shmThread.join();
+			}
+			{
+				// waits for the queue senders, see _QueueSender
+				std::lock_guard<std::mutex> guard(_sendMutex);
+				_ipcEndpoints.clear();
+				_stoppingQueueSenders.clear();
+			}
+			_shmDoorbell.reset();
+		}
+
+		// Called from the pose thread, which must neither block nor allocate. The replies are sent by the next runFrame(),
+		// which also puts the device back into default mode on failure.
+		void IpcShmCommunicator::sendReplySetMotionCompensationMode(uint32_t deviceId, bool success)
+		{
+			_zeroRefResult.store(((uint64_t)(success ? _zeroRefSuccess : _zeroRefFailure) << 32) | deviceId, std::memory_order_release);
+		}
+
+		// Expects _sendMutex to be held
+		void IpcShmCommunicator::_dropPendingOperations(uint32_t clientId)
+		{
+			auto& ops = _pendingMotionCompensationOperations;
+			ops.erase(std::remove_if(ops.begin(), ops.end(), [clientId](const _PendingOperation& op) { return op.clientId == clientId; }), ops.end());
 		}
 
-		void IpcShmCommunicator::sendReplySetMotionCompensationMode(bool success)
+		// Sends a reply for every pending operation the given function returns a status other than None for, and forgets them.
+		// Expects _sendMutex to be held.
+		template<typename Outcome>
+		void IpcShmCommunicator::_finishPendingOperations(const Outcome& outcome)
 		{
-			if (_setMotionCompensationMessageId != 0)
+			auto& ops = _pendingMotionCompensationOperations;
+			for (auto i = ops.begin(); i != ops.end();)
 			{
-				ipc::Reply resp(ipc::ReplyType::GenericReply);
-				resp.messageId = _setMotionCompensationMessageId;
-				if (success)
+				auto status = outcome(*i);
+				if (status != ipc::ReplyStatus::None)
 				{
-					resp.status = ipc::ReplyStatus::Ok;
+					auto e = _ipcEndpoints.find(i->clientId);
+					if (e != _ipcEndpoints.end())
+					{
+						ipc::Reply resp(ipc::ReplyType::GenericReply);
+						resp.messageId = i->messageId;
+						resp.status = status;
+						_sendToEndpoint(i->clientId, e->second, resp);
+					}
+					i = ops.erase(i);
 				}
 				else
 				{
-					resp.status = ipc::ReplyStatus::NotTracking;
+					++i;
 				}
-				sendReply(_setMotionCompensationClientId, resp);
 			}
-			_setMotionCompensationMessageId = 0;
 		}
 
 		void IpcShmCommunicator::_ipcThreadFunc(IpcShmCommunicator* _this, ServerDriver* driver)
 		{
 			_this->_ipcThreadRunning = true;
+			PROFILE_THREAD_NAME("ipc");
 			LOG(DEBUG) << "CServerDriver::_ipcThreadFunc: thread started";
 			try
 			{
-		   // Create message queue
-				boost::interprocess::message_queue::remove(_this->_ipcQueueName.c_str());
-				boost::interprocess::message_queue messageQueue(
-					boost::interprocess::create_only,
-					_this->_ipcQueueName.c_str(),
-					100,					//max message number
-					sizeof(ipc::Request)    //max message size
-				);
-
+				auto& messageQueue = *_this->_ipcQueue;
+				std::vector<uint8_t> frame(ipc::MaxFrameSize);
 				while (!_this->_ipcThreadStopFlag)
 				{
 					try
 					{
-						ipc::Request message;
 						uint64_t recv_size;
 						unsigned priority;
-						boost::posix_time::ptime timeout = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(50);
-						if (messageQueue.timed_receive(&message, sizeof(ipc::Request), recv_size, priority, timeout))
+						messageQueue.receive(frame.data(), frame.size(), recv_size, priority);
+						ipc::FrameReader<ipc::Request> reader(frame.data(), (size_t)recv_size);
+						ipc::Request message;
+						uint32_t legacyReplySize = reader.valid() ? 0 : ipc::readLegacyClientConnect(frame.data(), (size_t)recv_size, message);
+						if (legacyReplySize != 0)
 						{
-							LOG(TRACE) << "CServerDriver::_ipcThreadFunc: IPC request received ( type " << (int)message.type << ")";
-							if (recv_size == sizeof(ipc::Request))
-							{
-								switch (message.type)
-								{
-
-								case ipc::RequestType::IPC_ClientConnect:
-								{
-									try
-									{
-										auto queue = std::make_shared<boost::interprocess::message_queue>(boost::interprocess::open_only, message.msg.ipc_ClientConnect.queueName);
-										ipc::Reply reply(ipc::ReplyType::IPC_ClientConnect);
-										reply.messageId = message.msg.ipc_ClientConnect.messageId;
-										reply.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
-										uint32_t clientId = 0;
-										if (message.msg.ipc_ClientConnect.ipcProcotolVersion == IPC_PROTOCOL_VERSION)
-										{
-											clientId = _this->_ipcClientIdNext++;
-											_this->_ipcEndpoints.insert({ clientId, queue });
-											reply.msg.ipc_ClientConnect.clientId = clientId;
-											reply.status = ipc::ReplyStatus::Ok;
-											LOG(INFO) << "New client connected: endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\", cliendId " << clientId;
-										}
-										else
-										{
-											reply.msg.ipc_ClientConnect.clientId = 0;
-											reply.status = ipc::ReplyStatus::InvalidVersion;
-											LOG(INFO) << "Client (endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\") reports incompatible ipc version "
-												<< message.msg.ipc_ClientConnect.ipcProcotolVersion;
-										}
-										_this->sendReply(clientId, reply);
-									}
-									catch (std::exception & e)
-									{
-										LOG(ERROR) << "Error during client connect: " << e.what();
-									}
-								}
-								break;
-
-								case ipc::RequestType::IPC_ClientDisconnect:
-								{
-									ipc::Reply reply(ipc::ReplyType::GenericReply);
-									reply.messageId = message.msg.ipc_ClientDisconnect.messageId;
-									auto i = _this->_ipcEndpoints.find(message.msg.ipc_ClientDisconnect.clientId);
-									if (i != _this->_ipcEndpoints.end())
-									{
-										reply.status = ipc::ReplyStatus::Ok;
-										LOG(INFO) << "Client disconnected: clientId " << message.msg.ipc_ClientDisconnect.clientId;
-										if (reply.messageId != 0)
-										{
-											_this->sendReply(message.msg.ipc_ClientDisconnect.clientId, reply);
-										}
-										_this->_ipcEndpoints.erase(i);
-									}
-									else
-									{
-										LOG(ERROR) << "Error during client disconnect: unknown clientID " << message.msg.ipc_ClientDisconnect.clientId;
-									}
-								}
-								break;
-
-								case ipc::RequestType::IPC_Ping:
-								{
-									LOG(TRACE) << "Ping received: clientId " << message.msg.ipc_Ping.clientId << ", nonce " << message.msg.ipc_Ping.nonce;
-									ipc::Reply reply(ipc::ReplyType::IPC_Ping);
-									reply.messageId = message.msg.ipc_Ping.messageId;
-									reply.status = ipc::ReplyStatus::Ok;
-									reply.msg.ipc_Ping.nonce = message.msg.ipc_Ping.nonce;
-									_this->sendReply(message.msg.ipc_ClientDisconnect.clientId, reply);
-								}
-								break;
-
-								case ipc::RequestType::OpenVR_VendorSpecificEvent:
-								{
-									driver->openvr_vendorSpecificEvent(message.msg.ovr_VendorSpecificEvent.deviceId, message.msg.ovr_VendorSpecificEvent.eventType,
-																	   message.msg.ovr_VendorSpecificEvent.eventData, message.msg.ovr_VendorSpecificEvent.timeOffset);
-								}
-								break;
-
-								case ipc::RequestType::DeviceManipulation_DefaultMode:
-								{
-									ipc::Reply resp(ipc::ReplyType::GenericReply);
-									resp.messageId = message.msg.ovr_GenericDeviceIdMessage.messageId;
-									if (message.msg.ovr_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount)
-									{
-										resp.status = ipc::ReplyStatus::InvalidId;
-									}
-									else
-									{
-										DeviceManipulationHandle* info = driver->getDeviceManipulationHandleById(message.msg.ovr_GenericDeviceIdMessage.deviceId);
-										if (!info)
-										{
-											resp.status = ipc::ReplyStatus::NotFound;
-										}
-										else
-										{
-											info->setDefaultMode();
-											resp.status = ipc::ReplyStatus::Ok;
-										}
-										LOG(INFO) << "Setting driver into default mode";
-									}
-									if (resp.status != ipc::ReplyStatus::Ok)
-									{
-										LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
-									}
-									if (resp.messageId != 0)
-									{
-										_this->sendReply(message.msg.ovr_GenericDeviceIdMessage.clientId, resp);
-									}
-								}
-								break;
-
-								case ipc::RequestType::DeviceManipulation_MotionCompensationMode:
-								{
-									ipc::Reply resp(ipc::ReplyType::GenericReply);
-									resp.messageId = message.msg.dm_MotionCompensationMode.messageId;
-									if (message.msg.dm_MotionCompensationMode.deviceId >= vr::k_unMaxTrackedDeviceCount)
-									{
-										resp.status = ipc::ReplyStatus::InvalidId;
-									}
-									else
-									{
-										DeviceManipulationHandle* info = driver->getDeviceManipulationHandleById(message.msg.dm_MotionCompensationMode.deviceId);
-										if (!info)
-										{
-											resp.status = ipc::ReplyStatus::NotFound;
-										}
-										else
-										{
-											auto serverDriver = ServerDriver::getInstance();
-											if (serverDriver)
-											{
-												LOG(INFO) << "Setting driver into motion compensation mode";
-												serverDriver->motionCompensation().setMotionCompensationVelAccMode(message.msg.dm_MotionCompensationMode.velAccCompensationMode);
-												info->setMotionCompensationMode();
-												_this->_setMotionCompensationMessageId = message.msg.dm_MotionCompensationMode.messageId;
-												_this->_setMotionCompensationClientId = message.msg.dm_MotionCompensationMode.clientId;
-												resp.status = ipc::ReplyStatus::Ok;
-											}
-											else
-											{
-												resp.status = ipc::ReplyStatus::UnknownError;
-											}
-										}
-									}
-									if (resp.status != ipc::ReplyStatus::Ok)
-									{
-										LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
-									}
-									if (resp.messageId != 0 && resp.status != ipc::ReplyStatus::Ok)
-									{
-										_this->sendReply(message.msg.dm_MotionCompensationMode.clientId, resp);
-									}
-								}
-								break;
-
-								case ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties:
-								{
-									ipc::Reply resp(ipc::ReplyType::GenericReply);
-									resp.messageId = message.msg.dm_SetMotionCompensationProperties.messageId;
-									auto serverDriver = ServerDriver::getInstance();
-									if (serverDriver)
-									{
-										LOG(INFO) << "Setting driver motion compensation properties";
-										if (message.msg.dm_SetMotionCompensationProperties.velAccCompensationModeValid)
-										{
-											serverDriver->motionCompensation().setMotionCompensationVelAccMode(message.msg.dm_SetMotionCompensationProperties.velAccCompensationMode);
-										}
-										if (message.msg.dm_SetMotionCompensationProperties.kalmanFilterProcessNoiseValid)
-										{
-											serverDriver->motionCompensation().setMotionCompensationKalmanProcessVariance(message.msg.dm_SetMotionCompensationProperties.kalmanFilterProcessNoise);
-										}
-										if (message.msg.dm_SetMotionCompensationProperties.kalmanFilterObservationNoiseValid)
-										{
-											serverDriver->motionCompensation().setMotionCompensationKalmanObservationVariance(message.msg.dm_SetMotionCompensationProperties.kalmanFilterObservationNoise);
-										}
-										if (message.msg.dm_SetMotionCompensationProperties.movingAverageWindowValid)
-										{
-											serverDriver->motionCompensation().setMotionCompensationMovingAverageWindow(message.msg.dm_SetMotionCompensationProperties.movingAverageWindow);
-										}
-										resp.status = ipc::ReplyStatus::Ok;
-									}
-									else
-									{
-										resp.status = ipc::ReplyStatus::UnknownError;
-									}
-									if (resp.status != ipc::ReplyStatus::Ok)
-									{
-										LOG(ERROR) << "Error while setting motion compensation properties: Error code " << (int)resp.status;
-									}
-									if (resp.messageId != 0)
-									{
-										_this->sendReply(message.msg.dm_SetMotionCompensationProperties.clientId, resp);
-									}
-								}
-								break;
-
-								default:
-									LOG(ERROR) << "Error in ipc server receive loop: Unknown message type (" << (int)message.type << ")";
-									break;
-								}
-							}
-							else
+							_this->_rejectLegacyClient(message, legacyReplySize);
+							continue;
+						}
+						while (reader.next(message))
+						{
+							if (message.type != ipc::RequestType::None) // None is only used to wake up this loop
 							{
-								LOG(ERROR) << "Error in ipc server receive loop: received size is wrong (" << recv_size << " != " << sizeof(ipc::Request) << ")";
+								ALOG(TRACE, "CServerDriver::_ipcThreadFunc: IPC request received ( type {})", message.type);
+								std::lock_guard<std::mutex> guard(_this->_requestMutex);
+								_this->_handleRequest(message);
 							}
 						}
+						if (!reader.valid())
+						{
+							LOG(ERROR) << "Error in ipc server receive loop: received malformed frame (" << recv_size << " bytes), client uses an incompatible ipc protocol?";
+						}
 					}
 					catch (std::exception & ex)
 					{
 						LOG(ERROR) << "Exception caught in ipc server receive loop: " << ex.what();
 					}
 				}
-				boost::interprocess::message_queue::remove(_this->_ipcQueueName.c_str());
 			}
 			catch (std::exception & ex)
 			{
@@ -295,6 +173,547 @@ namespace vrinputemulator
 			LOG(DEBUG) << "CServerDriver::_ipcThreadFunc: thread stopped";
 		}
 
+		// Answers the IPC_ClientConnect of a client from before the framing with an unframed InvalidVersion reply of the size it expects
+		void IpcShmCommunicator::_rejectLegacyClient(const ipc::Request& message, uint32_t replySize)
+		{
+			LOG(INFO) << "Client (endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\") reports incompatible ipc version "
+				<< message.msg.ipc_ClientConnect.ipcProcotolVersion << " (unframed messages)";
+			try
+			{
+				boost::interprocess::message_queue queue(boost::interprocess::open_only, message.msg.ipc_ClientConnect.queueName);
+				ipc::Reply reply(ipc::ReplyType::IPC_ClientConnect);
+				std::memset(&reply.msg, 0, sizeof(reply.msg));
+				reply.messageId = message.msg.ipc_ClientConnect.messageId;
+				reply.status = ipc::ReplyStatus::InvalidVersion;
+				reply.msg.ipc_ClientConnect.clientId = 0;
+				reply.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
+				if (!queue.try_send(&reply, replySize, 0))
+				{
+					LOG(ERROR) << "Error during client connect: could not send the reply to endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\"";
+				}
+			}
+			catch (std::exception & e)
+			{
+				LOG(ERROR) << "Error during client connect: " << e.what();
+			}
+		}
+
+		void IpcShmCommunicator::_shmThreadFunc(IpcShmCommunicator* _this)
+		{
+			_this->_shmThreadRunning = true;
+			PROFILE_THREAD_NAME("ipc shm");
+			LOG(DEBUG) << "IpcShmCommunicator::_shmThreadFunc: thread started";
+			auto& doorbell = (*_this->_shmDoorbell)->requestsAvailable;
+			std::vector<std::pair<uint32_t, std::shared_ptr<ipc::ShmMapping<ipc::ShmChannelBlock>>>> channels;
+			while (!_this->_ipcThreadStopFlag)
+			{
+				try
+				{
+					// clients ring the doorbell once per request, so this only returns when there is work (or on shutdown)
+					doorbell.wait();
+					if (_this->_ipcThreadStopFlag)
+					{
+						break;
+					}
+					channels.clear();
+					{
+						std::lock_guard<std::mutex> guard(_this->_sendMutex);
+						for (auto& e : _this->_ipcEndpoints)
+						{
+							if (e.second.channel)
+							{
+								channels.push_back({ e.first, e.second.channel });
+							}
+						}
+					}
+					for (auto& c : channels)
+					{
+						ipc::Request message;
+						while ((*c.second)->requests.tryPop(message))
+						{
+							ALOG(TRACE, "IpcShmCommunicator::_shmThreadFunc: IPC request received ( clientId {}, type {})", c.first, message.type);
+							// a channel belongs to exactly one client, it must not act on behalf of another one
+							if (!_requestComesFrom(message, c.first))
+							{
+								LOG(ERROR) << "Error in shared memory receive loop: client " << c.first << " sent a request of type " << (int)message.type << " for another client";
+								continue;
+							}
+							std::lock_guard<std::mutex> guard(_this->_requestMutex);
+							_this->_handleRequest(message);
+						}
+					}
+				}
+				catch (std::exception & ex)
+				{
+					LOG(ERROR) << "Exception caught in shared memory receive loop: " << ex.what();
+				}
+			}
+			_this->_shmThreadRunning = false;
+			LOG(DEBUG) << "IpcShmCommunicator::_shmThreadFunc: thread stopped";
+		}
+
+		// Whether a request received over the shared memory channel of the given client names that client
+		bool IpcShmCommunicator::_requestComesFrom(const ipc::Request& message, uint32_t clientId)
+		{
+			switch (message.type)
+			{
+			case ipc::RequestType::IPC_ClientConnect:
+				return false; // clients connect over the message queue only
+			case ipc::RequestType::OpenVR_VendorSpecificEvent:
+				return true; // carries no client id
+			default:
+				// all other requests start with the client id
+				return message.msg.ovr_GenericClientMessage.clientId == clientId;
+			}
+		}
+
+		void IpcShmCommunicator::_handleRequest(const ipc::Request& message)
+		{
+			PROFILE_ZONE("IpcShmCommunicator::_handleRequest");
+			switch (message.type)
+			{
+
+			case ipc::RequestType::IPC_ClientConnect:
+			{
+				try
+				{
+					auto queue = std::make_shared<boost::interprocess::message_queue>(boost::interprocess::open_only, message.msg.ipc_ClientConnect.queueName);
+					ipc::Reply reply(ipc::ReplyType::IPC_ClientConnect);
+					reply.messageId = message.msg.ipc_ClientConnect.messageId;
+					reply.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
+					reply.msg.ipc_ClientConnect.shmChannelAccepted = false;
+					uint32_t clientId = 0;
+					std::shared_ptr<ipc::ShmMapping<ipc::ShmChannelBlock>> channel;
+					if (message.msg.ipc_ClientConnect.ipcProcotolVersion == IPC_PROTOCOL_VERSION)
+					{
+						clientId = _ipcClientIdNext++;
+						std::string channelName(message.msg.ipc_ClientConnect.shmChannelName, strnlen(message.msg.ipc_ClientConnect.shmChannelName, sizeof(message.msg.ipc_ClientConnect.shmChannelName)));
+						if (!channelName.empty() && _shmDoorbell)
+						{
+							try
+							{
+								channel = ipc::ShmMapping<ipc::ShmChannelBlock>::open(channelName);
+							}
+							catch (std::exception & e)
+							{
+								LOG(WARNING) << "Could not open shared memory channel \"" << channelName << "\", falling back to message queue: " << e.what();
+							}
+						}
+						reply.msg.ipc_ClientConnect.clientId = clientId;
+						reply.msg.ipc_ClientConnect.shmChannelAccepted = channel != nullptr;
+						reply.status = ipc::ReplyStatus::Ok;
+						LOG(INFO) << "New client connected: endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\", cliendId " << clientId
+							<< (channel ? ", using shared memory channel" : "");
+					}
+					else
+					{
+						reply.msg.ipc_ClientConnect.clientId = 0;
+						reply.status = ipc::ReplyStatus::InvalidVersion;
+						LOG(INFO) << "Client (endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\") reports incompatible ipc version "
+							<< message.msg.ipc_ClientConnect.ipcProcotolVersion;
+					}
+					if (clientId != 0)
+					{
+						// The endpoint is complete (channel included) before the client learns its id, so the shared memory thread
+						// already serves the channel when the first request arrives.
+						_IpcEndpoint endpoint;
+						endpoint.channel = channel;
+						if (!channel)
+						{
+							endpoint.sender.reset(new _QueueSender(queue, clientId));
+						}
+						endpoint.sentCount++;
+						std::lock_guard<std::mutex> guard(_sendMutex);
+						_ipcEndpoints[clientId] = std::move(endpoint);
+					}
+					// The connect reply is the only one that goes over the message queue from here, without _sendMutex. try_send() can only
+					// block this thread, and only when the client dies inside a send() of its own during the handshake.
+					ipc::FrameWriter<ipc::Reply> frame;
+					frame.append(reply);
+					if (!queue->try_send(frame.data(), frame.size(), 0))
+					{
+						LOG(ERROR) << "Error during client connect: could not send the reply to endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\"";
+						std::lock_guard<std::mutex> guard(_sendMutex);
+						auto i = _ipcEndpoints.find(clientId);
+						if (i != _ipcEndpoints.end())
+						{
+							_eraseEndpoint(i, false);
+						}
+					}
+				}
+				catch (std::exception & e)
+				{
+					LOG(ERROR) << "Error during client connect: " << e.what();
+				}
+			}
+			break;
+
+			case ipc::RequestType::IPC_ClientDisconnect:
+			{
+				ipc::Reply reply(ipc::ReplyType::GenericReply);
+				reply.messageId = message.msg.ipc_ClientDisconnect.messageId;
+				bool known;
+				{
+					std::lock_guard<std::mutex> guard(_sendMutex);
+					known = _ipcEndpoints.find(message.msg.ipc_ClientDisconnect.clientId) != _ipcEndpoints.end();
+				}
+				if (known)
+				{
+					reply.status = ipc::ReplyStatus::Ok;
+					LOG(INFO) << "Client disconnected: clientId " << message.msg.ipc_ClientDisconnect.clientId;
+					if (reply.messageId != 0)
+					{
+						sendReply(message.msg.ipc_ClientDisconnect.clientId, reply);
+					}
+					std::lock_guard<std::mutex> guard(_sendMutex);
+					auto i = _ipcEndpoints.find(message.msg.ipc_ClientDisconnect.clientId);
+					if (i != _ipcEndpoints.end())
+					{
+						_eraseEndpoint(i, false);
+					}
+				}
+				else
+				{
+					LOG(ERROR) << "Error during client disconnect: unknown clientID " << message.msg.ipc_ClientDisconnect.clientId;
+				}
+			}
+			break;
+
+			case ipc::RequestType::IPC_Ping:
+			{
+				LOG(TRACE) << "Ping received: clientId " << message.msg.ipc_Ping.clientId << ", nonce " << message.msg.ipc_Ping.nonce;
+				ipc::Reply reply(ipc::ReplyType::IPC_Ping);
+				reply.messageId = message.msg.ipc_Ping.messageId;
+				reply.status = ipc::ReplyStatus::Ok;
+				reply.msg.ipc_Ping.nonce = message.msg.ipc_Ping.nonce;
+				sendReply(message.msg.ipc_ClientDisconnect.clientId, reply);
+			}
+			break;
+
+			case ipc::RequestType::IPC_Subscribe:
+			{
+				ipc::Reply reply(ipc::ReplyType::GenericReply);
+				reply.messageId = message.msg.ipc_Subscribe.messageId;
+				{
+					std::lock_guard<std::mutex> guard(_sendMutex);
+					auto i = _ipcEndpoints.find(message.msg.ipc_Subscribe.clientId);
+					if (i != _ipcEndpoints.end())
+					{
+						i->second.eventMask = message.msg.ipc_Subscribe.eventMask;
+						reply.status = ipc::ReplyStatus::Ok;
+					}
+					else
+					{
+						reply.status = ipc::ReplyStatus::InvalidId;
+					}
+				}
+				LOG(INFO) << "Client " << message.msg.ipc_Subscribe.clientId << " subscribed to events " << message.msg.ipc_Subscribe.eventMask;
+				if (reply.messageId != 0)
+				{
+					sendReply(message.msg.ipc_Subscribe.clientId, reply);
+				}
+			}
+			break;
+
+			case ipc::RequestType::OpenVR_VendorSpecificEvent:
+			{
+				_driver->openvr_vendorSpecificEvent(message.msg.ovr_VendorSpecificEvent.deviceId, message.msg.ovr_VendorSpecificEvent.eventType,
+												   message.msg.ovr_VendorSpecificEvent.eventData, message.msg.ovr_VendorSpecificEvent.timeOffset);
+			}
+			break;
+
+			case ipc::RequestType::DeviceManipulation_GetDeviceInfo:
+			{
+				ipc::Reply resp(ipc::ReplyType::DeviceManipulation_GetDeviceInfo);
+				resp.messageId = message.msg.ovr_GenericDeviceIdMessage.messageId;
+				if (message.msg.ovr_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount)
+				{
+					resp.status = ipc::ReplyStatus::InvalidId;
+				}
+				else
+				{
+					DeviceManipulationHandle* info = _driver->getDeviceManipulationHandleById(message.msg.ovr_GenericDeviceIdMessage.deviceId);
+					if (!info)
+					{
+						resp.status = ipc::ReplyStatus::NotFound;
+					}
+					else
+					{
+						auto refDevice = _driver->motionCompensation().getMotionCompensationRefDevice();
+						_fillDeviceInfo(info, refDevice ? refDevice->openvrId() : vr::k_unTrackedDeviceIndexInvalid, resp.msg.dm_deviceInfo);
+						resp.status = ipc::ReplyStatus::Ok;
+					}
+				}
+				if (resp.messageId != 0)
+				{
+					sendReply(message.msg.ovr_GenericDeviceIdMessage.clientId, resp);
+				}
+			}
+			break;
+
+			case ipc::RequestType::DeviceManipulation_GetAllDeviceInfos:
+			{
+				// everything a dashboard refresh needs in a single reply
+				ipc::Reply resp(ipc::ReplyType::DeviceManipulation_GetAllDeviceInfos);
+				resp.messageId = message.msg.ovr_GenericClientMessage.messageId;
+				auto& motionCompensation = _driver->motionCompensation();
+				auto refDevice = motionCompensation.getMotionCompensationRefDevice();
+				uint32_t refDeviceId = refDevice ? refDevice->openvrId() : vr::k_unTrackedDeviceIndexInvalid;
+				resp.msg.dm_allDeviceInfos.motionCompensationStatus = motionCompensation.motionCompensationStatus();
+				resp.msg.dm_allDeviceInfos.deviceCount = 0;
+				for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; ++id)
+				{
+					DeviceManipulationHandle* info = _driver->getDeviceManipulationHandleById(id);
+					if (info)
+					{
+						_fillDeviceInfo(info, refDeviceId, resp.msg.dm_allDeviceInfos.devices[resp.msg.dm_allDeviceInfos.deviceCount++]);
+					}
+				}
+				resp.status = ipc::ReplyStatus::Ok;
+				if (resp.messageId != 0)
+				{
+					sendReply(message.msg.ovr_GenericClientMessage.clientId, resp);
+				}
+			}
+			break;
+
+			case ipc::RequestType::Stats_ResetHistograms:
+			{
+				auto stats = _driver->stats();
+				if (stats)
+				{
+					for (auto& histograms : stats->poseHook)
+					{
+						histograms.processing.reset();
+						histograms.steamvr.reset();
+					}
+				}
+				if (message.msg.ovr_GenericClientMessage.messageId != 0)
+				{
+					ipc::Reply resp(ipc::ReplyType::GenericReply);
+					resp.messageId = message.msg.ovr_GenericClientMessage.messageId;
+					resp.status = stats ? ipc::ReplyStatus::Ok : ipc::ReplyStatus::InvalidOperation;
+					sendReply(message.msg.ovr_GenericClientMessage.clientId, resp);
+				}
+			}
+			break;
+
+			case ipc::RequestType::Profiler_WriteTrace:
+			{
+				ipc::ReplyStatus status;
+				if (!Profiler::enabled())
+				{
+					status = ipc::ReplyStatus::InvalidOperation;
+				}
+				else
+				{
+					std::string filename(message.msg.prof_WriteTrace.filename, strnlen(message.msg.prof_WriteTrace.filename, sizeof(message.msg.prof_WriteTrace.filename)));
+					auto path = _traceFilePath(filename);
+					if (path.empty())
+					{
+						LOG(ERROR) << "Refusing to write trace file \"" << filename << "\": only a bare file name is allowed";
+						status = ipc::ReplyStatus::InvalidParameter;
+					}
+					else
+					{
+						status = Profiler::writeChromeTrace(path) ? ipc::ReplyStatus::Ok : ipc::ReplyStatus::UnknownError;
+					}
+				}
+				if (message.msg.prof_WriteTrace.messageId != 0)
+				{
+					ipc::Reply resp(ipc::ReplyType::GenericReply);
+					resp.messageId = message.msg.prof_WriteTrace.messageId;
+					resp.status = status;
+					sendReply(message.msg.prof_WriteTrace.clientId, resp);
+				}
+			}
+			break;
+
+			case ipc::RequestType::DeviceManipulation_DefaultMode:
+			{
+				ipc::Reply resp(ipc::ReplyType::GenericReply);
+				resp.messageId = message.msg.ovr_GenericDeviceIdMessage.messageId;
+				if (message.msg.ovr_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount)
+				{
+					resp.status = ipc::ReplyStatus::InvalidId;
+				}
+				else
+				{
+					DeviceManipulationHandle* info = _driver->getDeviceManipulationHandleById(message.msg.ovr_GenericDeviceIdMessage.deviceId);
+					if (!info)
+					{
+						resp.status = ipc::ReplyStatus::NotFound;
+					}
+					else
+					{
+						info->setDefaultMode();
+						resp.status = ipc::ReplyStatus::Ok;
+					}
+					LOG(INFO) << "Setting driver into default mode";
+				}
+				if (resp.status != ipc::ReplyStatus::Ok)
+				{
+					LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
+				}
+				if (resp.messageId != 0)
+				{
+					sendReply(message.msg.ovr_GenericDeviceIdMessage.clientId, resp);
+				}
+			}
+			break;
+
+			case ipc::RequestType::DeviceManipulation_MotionCompensationMode:
+			{
+				auto& request = message.msg.dm_MotionCompensationMode;
+				ipc::Reply resp(ipc::ReplyType::GenericReply);
+				resp.messageId = request.messageId;
+				resp.status = _enableMotionCompensation(request.clientId, request.messageId, request.deviceId, [&request](MotionCompensationManager& motionCompensation)
+														{
+															motionCompensation.setMotionCompensationVelAccMode(request.velAccCompensationMode);
+														});
+				if (resp.status != ipc::ReplyStatus::Ok)
+				{
+					LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
+					if (resp.messageId != 0)
+					{
+						sendReply(request.clientId, resp);
+					}
+				}
+			}
+			break;
+
+			case ipc::RequestType::DeviceManipulation_ApplyMotionCompensation:
+			{
+				auto& request = message.msg.dm_ApplyMotionCompensation;
+				ipc::Reply resp(ipc::ReplyType::GenericReply);
+				resp.messageId = request.messageId;
+				resp.status = _enableMotionCompensation(request.clientId, request.messageId, request.deviceId, [&request](MotionCompensationManager& motionCompensation)
+														{
+															motionCompensation.applyMotionCompensationConfig(request.velAccCompensationMode, request.kalmanFilterProcessNoise,
+																											 request.kalmanFilterObservationNoise, request.rotKalmanFilterProcessNoise,
+																											 request.rotKalmanFilterObservationNoise, request.movingAverageWindow);
+														});
+				if (resp.status != ipc::ReplyStatus::Ok)
+				{
+					LOG(ERROR) << "Error while applying motion compensation: Error code " << (int)resp.status;
+					if (resp.messageId != 0)
+					{
+						sendReply(request.clientId, resp);
+					}
+				}
+			}
+			break;
+
+			case ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties:
+			{
+				ipc::Reply resp(ipc::ReplyType::GenericReply);
+				resp.messageId = message.msg.dm_SetMotionCompensationProperties.messageId;
+				auto serverDriver = ServerDriver::getInstance();
+				if (serverDriver)
+				{
+					LOG(INFO) << "Setting driver motion compensation properties";
+					if (message.msg.dm_SetMotionCompensationProperties.velAccCompensationModeValid)
+					{
+						serverDriver->motionCompensation().setMotionCompensationVelAccMode(message.msg.dm_SetMotionCompensationProperties.velAccCompensationMode);
+					}
+					if (message.msg.dm_SetMotionCompensationProperties.kalmanFilterProcessNoiseValid)
+					{
+						serverDriver->motionCompensation().setMotionCompensationKalmanProcessVariance(message.msg.dm_SetMotionCompensationProperties.kalmanFilterProcessNoise);
+					}
+					if (message.msg.dm_SetMotionCompensationProperties.kalmanFilterObservationNoiseValid)
+					{
+						serverDriver->motionCompensation().setMotionCompensationKalmanObservationVariance(message.msg.dm_SetMotionCompensationProperties.kalmanFilterObservationNoise);
+					}
+					if (message.msg.dm_SetMotionCompensationProperties.rotKalmanFilterNoiseValid)
+					{
+						serverDriver->motionCompensation().setMotionCompensationRotKalmanVariances(message.msg.dm_SetMotionCompensationProperties.rotKalmanFilterProcessNoise,
+																								   message.msg.dm_SetMotionCompensationProperties.rotKalmanFilterObservationNoise);
+					}
+					if (message.msg.dm_SetMotionCompensationProperties.movingAverageWindowValid)
+					{
+						serverDriver->motionCompensation().setMotionCompensationMovingAverageWindow(message.msg.dm_SetMotionCompensationProperties.movingAverageWindow);
+					}
+					resp.status = ipc::ReplyStatus::Ok;
+				}
+				else
+				{
+					resp.status = ipc::ReplyStatus::UnknownError;
+				}
+				if (resp.status != ipc::ReplyStatus::Ok)
+				{
+					LOG(ERROR) << "Error while setting motion compensation properties: Error code " << (int)resp.status;
+				}
+				if (resp.messageId != 0)
+				{
+					sendReply(message.msg.dm_SetMotionCompensationProperties.clientId, resp);
+				}
+			}
+			break;
+
+			default:
+				LOG(ERROR) << "Error in ipc server receive loop: Unknown message type (" << (int)message.type << ")";
+				break;
+			}
+		}
+
+
+		// Applies the motion compensation settings and puts the device into motion compensation mode.
+		// On success the reply is deferred until the zero reference has been captured, see sendReplySetMotionCompensationMode.
+		ipc::ReplyStatus IpcShmCommunicator::_enableMotionCompensation(uint32_t clientId, uint32_t messageId, uint32_t deviceId,
+																	   const std::function<void(MotionCompensationManager&)>& configure)
+		{
+			if (deviceId >= vr::k_unMaxTrackedDeviceCount)
+			{
+				return ipc::ReplyStatus::InvalidId;
+			}
+			DeviceManipulationHandle* info = _driver->getDeviceManipulationHandleById(deviceId);
+			if (!info)
+			{
+				return ipc::ReplyStatus::NotFound;
+			}
+			LOG(INFO) << "Setting driver into motion compensation mode";
+			{
+				std::lock_guard<std::mutex> guard(_sendMutex);
+				// there is only one motion reference, requests still waiting for another device will never see their zero reference
+				_finishPendingOperations([deviceId](const _PendingOperation& op)
+										 {
+											 return op.deviceId != deviceId ? ipc::ReplyStatus::InvalidOperation : ipc::ReplyStatus::None;
+										 });
+				_zeroRefResult.store(0, std::memory_order_relaxed); // a result of the previous zero reference must not answer this request
+				if (messageId != 0)
+				{
+					_pendingMotionCompensationOperations.push_back({ clientId, messageId, deviceId, MonotonicClock::now() + _pendingOperationTimeout });
+				}
+				_evictDeadEndpoints();
+			}
+			configure(_driver->motionCompensation());
+			info->setMotionCompensationMode();
+			return ipc::ReplyStatus::Ok;
+		}
+
+
+		void IpcShmCommunicator::_fillDeviceInfo(DeviceManipulationHandle* handle, uint32_t refDeviceId, ipc::Reply_DeviceManipulation_GetDeviceInfo& info)
+		{
+			info.deviceId = handle->openvrId();
+			info.deviceClass = handle->deviceClass();
+			info.deviceMode = handle->deviceMode();
+			info.refDeviceId = refDeviceId;
+		}
+
+
+		// Where a trace requested by a client goes. Any local process can send that request, so it only gets to pick a file name in
+		// the driver's log directory, not make SteamVR overwrite whatever it likes. Empty when the name is not a bare file name.
+		std::string IpcShmCommunicator::_traceFilePath(const std::string& name)
+		{
+			if (name.empty() || name.find_first_of("/\\:") != std::string::npos || name.find("..") != std::string::npos)
+			{
+				return std::string();
+			}
+			auto logFile = el::Loggers::getLogger("default")->typedConfigurations()->filename(el::Level::Info);
+			auto separator = logFile.find_last_of("/\\");
+			return separator == std::string::npos ? name : logFile.substr(0, separator + 1) + name;
+		}
+
 
 		void IpcShmCommunicator::sendReply(uint32_t clientId, const ipc::Reply& reply)
 		{
@@ -302,12 +721,295 @@ namespace vrinputemulator
 			auto i = _ipcEndpoints.find(clientId);
 			if (i != _ipcEndpoints.end())
 			{
-				i->second->send(&reply, sizeof(ipc::Reply), 0);
+				_sendToEndpoint(clientId, i->second, reply);
+				_evictDeadEndpoints();
+			}
+			else
+			{
+				ALOG(ERROR, "Error while sending reply: Unknown clientId {}", clientId);
+			}
+		}
+
+		void IpcShmCommunicator::publishEvent(const DriverEvent& event)
+		{
+			ipc::Reply reply(ipc::ReplyType::IPC_Event);
+			reply.messageId = 0;
+			reply.status = ipc::ReplyStatus::Ok;
+			reply.msg.ipc_Event = event;
+			std::lock_guard<std::mutex> guard(_sendMutex);
+			for (auto& e : _ipcEndpoints)
+			{
+				if (e.second.eventMask & (uint32_t)event.type)
+				{
+					_sendToEndpoint(e.first, e.second, reply);
+				}
+			}
+			_evictDeadEndpoints();
+		}
+
+		void IpcShmCommunicator::runFrame()
+		{
+			uint64_t zeroRefResult;
+			{
+				std::unique_lock<std::mutex> lock(_sendMutex, std::try_to_lock);
+				if (!lock.owns_lock())
+				{
+					return; // the zero reference outcome stays where it is and is picked up next frame
+				}
+				zeroRefResult = _zeroRefResult.exchange(0, std::memory_order_acquire);
+				if (!_pendingMotionCompensationOperations.empty())
+				{
+					auto now = MonotonicClock::now();
+					_finishPendingOperations([zeroRefResult, now](const _PendingOperation& op)
+											 {
+												 if (zeroRefResult != 0 && op.deviceId == (uint32_t)zeroRefResult)
+												 {
+													 return (zeroRefResult >> 32) == _zeroRefSuccess ? ipc::ReplyStatus::Ok : ipc::ReplyStatus::NotTracking;
+												 }
+												 return now > op.deadline ? ipc::ReplyStatus::NotTracking : ipc::ReplyStatus::None;
+											 });
+				}
+				for (auto& e : _ipcEndpoints)
+				{
+					_flushBacklog(e.first, e.second);
+				}
+				_evictDeadEndpoints();
+				auto& senders = _stoppingQueueSenders;
+				senders.erase(std::remove_if(senders.begin(), senders.end(), [](const std::unique_ptr<_QueueSender>& s) { return s->finished(); }), senders.end());
+			}
+			if (zeroRefResult != 0 && (zeroRefResult >> 32) != _zeroRefSuccess)
+			{
+				// The pose thread cannot switch modes itself, switching takes the device mutex and publishes an event.
+				// Done without _sendMutex, publishing the event needs it.
+				auto handle = _driver->getDeviceManipulationHandleById((uint32_t)zeroRefResult);
+				if (handle && _driver->motionCompensation().getMotionCompensationRefDevice() == handle)
+				{
+					handle->setDefaultMode();
+				}
+			}
+		}
+
+		// Expects _sendMutex to be held
+		void IpcShmCommunicator::_sendToEndpoint(uint32_t clientId, _IpcEndpoint& endpoint, const ipc::Reply& reply)
+		{
+			if (endpoint.evict)
+			{
+				return;
+			}
+			_flushBacklog(clientId, endpoint);
+			if (endpoint.backlog.empty() && _tryDeliver(endpoint, reply))
+			{
+				return;
+			}
+			if (reply.type == ipc::ReplyType::IPC_Event)
+			{
+				// the client only needs to know the latest state of a device
+				for (auto& r : endpoint.backlog)
+				{
+					if (r.type == ipc::ReplyType::IPC_Event && r.msg.ipc_Event.type == reply.msg.ipc_Event.type && r.msg.ipc_Event.deviceId == reply.msg.ipc_Event.deviceId)
+					{
+						r = reply;
+						endpoint.coalescedEventCount++;
+						return;
+					}
+				}
+				if (endpoint.backlog.size() >= _maxBacklog)
+				{
+					endpoint.droppedEventCount++;
+					return;
+				}
+			}
+			else if (endpoint.backlog.size() >= _maxBacklog)
+			{
+				// somebody is waiting for this reply, dropping it would hang the client, so give up on the client instead
+				ALOG(WARNING, "Backlog of client {} is full, evicting it", clientId);
+				endpoint.evict = true;
+				return;
+			}
+			if (endpoint.stalledSince == 0)
+			{
+				endpoint.stalledSince = MonotonicClock::now();
+				ALOG(WARNING, "Client {} does not keep up, backlogging replies", clientId);
+			}
+			endpoint.backlog.push_back(reply);
+			endpoint.backloggedCount++;
+		}
+
+		// Expects _sendMutex to be held
+		bool IpcShmCommunicator::_tryDeliver(_IpcEndpoint& endpoint, const ipc::Reply& reply)
+		{
+			bool sent;
+			if (endpoint.channel)
+			{
+				auto& channel = *endpoint.channel;
+				sent = channel->replies.tryPush(reply, ipc::messageSize(reply));
+				if (sent)
+				{
+					channel->repliesAvailable.post();
+				}
 			}
 			else
 			{
-				LOG(ERROR) << "Error while sending reply: Unknown clientId " << clientId;
+				sent = endpoint.sender->tryPost(reply);
+			}
+			if (sent)
+			{
+				endpoint.sentCount++;
+			}
+			return sent;
+		}
+
+		// Expects _sendMutex to be held
+		void IpcShmCommunicator::_flushBacklog(uint32_t clientId, _IpcEndpoint& endpoint)
+		{
+			if (endpoint.channel && (*endpoint.channel)->closed)
+			{
+				ALOG(WARNING, "Shared memory channel of client {} is closed, evicting it", clientId);
+				endpoint.evict = true;
+				return;
+			}
+			while (!endpoint.backlog.empty() && _tryDeliver(endpoint, endpoint.backlog.front()))
+			{
+				endpoint.backlog.pop_front();
+			}
+			if (endpoint.backlog.empty())
+			{
+				if (endpoint.stalledSince != 0)
+				{
+					ALOG(INFO, "Client {} caught up again", clientId);
+				}
+				endpoint.stalledSince = 0;
+			}
+			else if (MonotonicClock::now() - endpoint.stalledSince > _stallTimeout)
+			{
+				ALOG(WARNING, "Client {} did not accept replies for {} seconds, evicting it", clientId, MonotonicClock::toSeconds(_stallTimeout));
+				endpoint.evict = true;
+			}
+		}
+
+		// Expects _sendMutex to be held
+		void IpcShmCommunicator::_evictDeadEndpoints()
+		{
+			for (auto i = _ipcEndpoints.begin(); i != _ipcEndpoints.end();)
+			{
+				if (i->second.evict)
+				{
+					auto& e = i->second;
+					ALOG(INFO, "Evicted client {}: {} sent, {} backlogged, {} undelivered, {} events coalesced, {} events dropped",
+						 i->first, e.sentCount, e.backloggedCount, e.backlog.size(), e.coalescedEventCount, e.droppedEventCount);
+					i = _eraseEndpoint(i, true);
+				}
+				else
+				{
+					++i;
+				}
+			}
+		}
+
+		// Expects _sendMutex to be held
+		std::map<uint32_t, IpcShmCommunicator::_IpcEndpoint>::iterator IpcShmCommunicator::_eraseEndpoint(std::map<uint32_t, _IpcEndpoint>::iterator i, bool evicted)
+		{
+			_dropPendingOperations(i->first);
+			if (evicted && i->second.channel)
+			{
+				// nobody reads the request ring anymore, the client must neither wait for replies nor for ring space
+				auto& channel = *i->second.channel;
+				channel->evicted = 1;
+				channel->repliesAvailable.post();
+			}
+			if (i->second.sender)
+			{
+				// the sender may be stuck in a dead client's queue, runFrame() joins it once it noticed
+				i->second.sender->stop();
+				_stoppingQueueSenders.push_back(std::move(i->second.sender));
+			}
+			return _ipcEndpoints.erase(i);
+		}
+
+
+		IpcShmCommunicator::_QueueSender::_QueueSender(std::shared_ptr<boost::interprocess::message_queue> queue, uint32_t clientId)
+			: _queue(std::move(queue)), _clientId(clientId)
+		{
+			_thread = std::thread(_threadFunc, this);
+		}
+
+		IpcShmCommunicator::_QueueSender::~_QueueSender()
+		{
+			stop();
+			if (_thread.joinable())
+			{
+				_thread.join();
+			}
+		}
+
+		bool IpcShmCommunicator::_QueueSender::tryPost(const ipc::Reply& reply)
+		{
+			std::lock_guard<std::mutex> guard(_mutex);
+			if (_stopFlag || _outbox.size() >= _maxBacklog)
+			{
+				return false;
+			}
+			_outbox.push_back(reply);
+			_wakeup.notify_one();
+			return true;
+		}
+
+		void IpcShmCommunicator::_QueueSender::stop()
+		{
+			std::lock_guard<std::mutex> guard(_mutex);
+			_stopFlag = true;
+			_wakeup.notify_one();
+		}
+
+		void IpcShmCommunicator::_QueueSender::_threadFunc(_QueueSender* _this)
+		{
+			PROFILE_THREAD_NAME("ipc queue sender");
+			ipc::FrameWriter<ipc::Reply> frame;
+			std::unique_lock<std::mutex> lock(_this->_mutex);
+			while (true)
+			{
+				_this->_wakeup.wait(lock, [_this]() { return _this->_stopFlag || !_this->_outbox.empty(); });
+				if (_this->_outbox.empty())
+				{
+					break; // stopped, everything delivered
+				}
+				// catch up with as few queue messages as possible
+				frame.clear();
+				for (auto& r : _this->_outbox)
+				{
+					if (!frame.append(r))
+					{
+						break;
+					}
+				}
+				lock.unlock();
+				bool sent = false;
+				bool failed = false;
+				try
+				{
+					// gives up now and then while the queue is full, to see a stop request
+					auto deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds(_queueSendTimeout / 1000);
+					sent = _this->_queue->timed_send(frame.data(), frame.size(), 0, deadline);
+				}
+				catch (std::exception& e)
+				{
+					ALOG(ERROR, "Error while sending to client {}: {}", _this->_clientId, e.what());
+					failed = true;
+				}
+				lock.lock();
+				if (sent)
+				{
+					_this->_outbox.erase(_this->_outbox.begin(), _this->_outbox.begin() + frame.count());
+				}
+				else if (failed || _this->_stopFlag)
+				{
+					// A stopped sender still delivers what is left (the reply to a disconnect, say), but does not wait for a full queue.
+					// After an error the outbox fills up, which gets the client evicted.
+					_this->_stopFlag = true;
+					break;
+				}
 			}
+			_this->_finished = true;
 		}
 
 	} // end namespace driver
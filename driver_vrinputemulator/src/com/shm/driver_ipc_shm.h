@@ -1,28 +1,31 @@
 #pragma once
 
+#include <atomic>
 #include <thread>
 #include <string>
 #include <map>
+#include <deque>
+#include <vector>
+#include <functional>
 #include <mutex>
+#include <condition_variable>
 #include <memory>
 #include <boost/interprocess/ipc/message_queue.hpp>
+#include <openvr_driver.h>
+#include <ipc_shm_channel.h>
 
 
 // driver namespace
 namespace vrinputemulator
 {
 
-	// forward declarations
-	namespace ipc
-	{
-		struct Reply;
-	}
-
 	namespace driver
 	{
 
 		// forward declarations
 		class ServerDriver;
+		class DeviceManipulationHandle;
+		class MotionCompensationManager;
 
 		class IpcShmCommunicator
 		{
@@ -30,25 +33,131 @@ namespace vrinputemulator
 			void init(ServerDriver* driver);
 			void shutdown();
 
-			void sendReplySetMotionCompensationMode(bool success);
+			// Answers all motion compensation mode requests still waiting for the zero reference of the given device.
+			// Only records the outcome, may be called from pose threads.
+			void sendReplySetMotionCompensationMode(uint32_t deviceId, bool success);
+
+			// Sends the event to all clients subscribed to its type.
+			// Waits for the send lock, so it must not be called from pose threads. They record state changes instead, and
+			// runFrame() publishes them (see MotionCompensationManager::runFrame).
+			void publishEvent(const DriverEvent& event);
+
+			// Answers finished motion compensation requests, retries backlogged replies and evicts dead clients.
+			// Called once per frame. Never waits for _sendMutex, when another thread is sending the whole frame is skipped.
+			// Switching a device back to default mode after a failed zero reference publishes an event, which does wait.
+			void runFrame();
 
 		private:
+			// The message queues are only used for the connect handshake. Afterwards replies and events go over the client's shared memory
+			// channel, whose ring never blocks the driver. A client without a channel gets a _QueueSender instead, so only that sender's
+			// thread ever waits for the client's message queue.
+			//
+			// Sending does not wait for a client. When a client does not keep up, replies to its requests wait in a bounded backlog, events are
+			// coalesced with a pending event of the same type and device, or dropped when the backlog is full.
+			// Senders do serialize on _sendMutex, which is held while delivering, so everything but runFrame() may wait for other senders.
+			// Nothing that can block (logging included, see ALOG) happens while it is held.
+			// A client whose backlog overflows or that has not accepted anything for _stallTimeout is considered dead and evicted.
+			class _QueueSender;
+			struct _IpcEndpoint
+			{
+				std::shared_ptr<ipc::ShmMapping<ipc::ShmChannelBlock>> channel;
+				std::unique_ptr<_QueueSender> sender; // clients without a channel
+				uint32_t eventMask = 0; // subscribed DriverEventType bits
+				std::deque<ipc::Reply> backlog; // not yet delivered, oldest first
+				int64_t stalledSince = 0; // see MonotonicClock, 0 .. client keeps up
+				bool evict = false;
+				uint64_t sentCount = 0;
+				uint64_t backloggedCount = 0;
+				uint64_t coalescedEventCount = 0;
+				uint64_t droppedEventCount = 0;
+			};
+
+			// Sends the replies of a client without shared memory channel over its message queue, from a thread of its own.
+			// message_queue::send() takes an interprocess lock without a timeout, a client that died while holding it only blocks this thread
+			// (and shutdown(), which joins it).
+			class _QueueSender
+			{
+			public:
+				_QueueSender(std::shared_ptr<boost::interprocess::message_queue> queue, uint32_t clientId);
+				~_QueueSender(); // waits for the thread
+				_QueueSender(const _QueueSender&) = delete;
+				_QueueSender& operator=(const _QueueSender&) = delete;
+
+				bool tryPost(const ipc::Reply& reply); // false when the outbox is full
+				void stop(); // does not wait for the thread
+				bool finished() const
+				{
+					return _finished;
+				}
+
+			private:
+				static void _threadFunc(_QueueSender* _this);
+
+				std::shared_ptr<boost::interprocess::message_queue> _queue;
+				uint32_t _clientId;
+				std::mutex _mutex; // guards _outbox and _stopFlag, never held while sending
+				std::condition_variable _wakeup;
+				std::deque<ipc::Reply> _outbox; // oldest first
+				bool _stopFlag = false;
+				std::atomic<bool> _finished = { false };
+				std::thread _thread;
+			};
+
+			// A request that is answered later, once the driver knows its outcome
+			struct _PendingOperation
+			{
+				uint32_t clientId;
+				uint32_t messageId;
+				uint32_t deviceId;
+				int64_t deadline; // see MonotonicClock
+			};
+
+			static const size_t _maxBacklog = 64;
+			static const int64_t _stallTimeout = 5000000000ll; // nanoseconds
+			static const int64_t _queueSendTimeout = 100000000; // nanoseconds, a sender waiting for a full queue checks for stop this often
+
 			static void _ipcThreadFunc(IpcShmCommunicator* _this, ServerDriver* driver);
+			static void _shmThreadFunc(IpcShmCommunicator* _this);
 
+			static bool _requestComesFrom(const ipc::Request& message, uint32_t clientId);
+			void _handleRequest(const ipc::Request& message);
+			void _rejectLegacyClient(const ipc::Request& message, uint32_t replySize);
+			ipc::ReplyStatus _enableMotionCompensation(uint32_t clientId, uint32_t messageId, uint32_t deviceId, const std::function<void(MotionCompensationManager&)>& configure);
+			static void _fillDeviceInfo(DeviceManipulationHandle* handle, uint32_t refDeviceId, ipc::Reply_DeviceManipulation_GetDeviceInfo& info);
+			static std::string _traceFilePath(const std::string& name);
 			void sendReply(uint32_t clientId, const ipc::Reply& reply);
+			void _sendToEndpoint(uint32_t clientId, _IpcEndpoint& endpoint, const ipc::Reply& reply);
+			bool _tryDeliver(_IpcEndpoint& endpoint, const ipc::Reply& reply);
+			void _flushBacklog(uint32_t clientId, _IpcEndpoint& endpoint);
+			void _evictDeadEndpoints();
+			std::map<uint32_t, _IpcEndpoint>::iterator _eraseEndpoint(std::map<uint32_t, _IpcEndpoint>::iterator i, bool evicted);
+			void _dropPendingOperations(uint32_t clientId);
+			template<typename Outcome> void _finishPendingOperations(const Outcome& outcome);
 
-			std::mutex _sendMutex;
+			std::mutex _sendMutex; // also guards _ipcEndpoints
+			std::mutex _requestMutex; // requests from the message queue and from shared memory channels are handled one at a time
 			ServerDriver* _driver = nullptr;
+			std::unique_ptr<boost::interprocess::message_queue> _ipcQueue;
 			std::thread _ipcThread;
 			volatile bool _ipcThreadRunning = false;
 			volatile bool _ipcThreadStopFlag = false;
 			std::string _ipcQueueName = "driver_vrinputemulator.server_queue";
 			uint32_t _ipcClientIdNext = 1;
-			std::map<uint32_t, std::shared_ptr<boost::interprocess::message_queue>> _ipcEndpoints;
+			std::map<uint32_t, _IpcEndpoint> _ipcEndpoints;
+			std::vector<std::unique_ptr<_QueueSender>> _stoppingQueueSenders; // of erased endpoints, joined by runFrame() once finished
+
+			std::thread _shmThread;
+			volatile bool _shmThreadRunning = false;
+			std::unique_ptr<ipc::ShmMapping<ipc::ShmDoorbellBlock>> _shmDoorbell;
+			std::string _shmDoorbellName = "driver_vrinputemulator.server_doorbell";
 
-			// This is not exactly multi-user safe, maybe I fix it in the future
-			uint32_t _setMotionCompensationClientId = 0;
-			uint32_t _setMotionCompensationMessageId = 0;
+			// Motion compensation mode requests waiting for the zero reference, from any number of clients. Guarded by _sendMutex.
+			std::vector<_PendingOperation> _pendingMotionCompensationOperations;
+			static const int64_t _pendingOperationTimeout = 10000000000ll; // nanoseconds, only a safety net, see MotionCompensationManager::runFrame
+			// Outcome of the last zero reference capture, handed from the pose thread to runFrame(): 0 .. none, else status << 32 | deviceId
+			std::atomic<uint64_t> _zeroRefResult = { 0 };
+			static const uint64_t _zeroRefSuccess = 1;
+			static const uint64_t _zeroRefFailure = 2;
 		};
 
 	} // end namespace driver
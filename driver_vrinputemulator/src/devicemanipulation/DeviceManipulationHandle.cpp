@@ -1,18 +1,9 @@
 #include "DeviceManipulationHandle.h"
 
-#include <boost/regex.hpp>
-#include <boost/algorithm/string.hpp>
 #include "../driver/ServerDriver.h"
 #include "../hooks/IVRServerDriverHost004Hooks.h"
 #include "../hooks/IVRServerDriverHost005Hooks.h"
 
-#undef WIN32_LEAN_AND_MEAN
-#undef NOSOUND
-#include <Windows.h>
-// According to windows documentation mmsystem.h should be automatically included with Windows.h when WIN32_LEAN_AND_MEAN and NOSOUND are not defined
-// But it doesn't work so I have to include it manually
-#include <mmsystem.h>
-
 
 namespace vrinputemulator
 {
@@ -30,11 +21,12 @@ namespace vrinputemulator
 		{
 		}
 
+		// Runs on the pose thread of the device driver. Does neither take _mutex nor publish events, mode switches from the ipc
+		// thread are picked up through m_deviceMode and the published motion compensation config.
 		bool DeviceManipulationHandle::handlePoseUpdate(uint32_t& unWhichDevice, vr::DriverPose_t& newPose, uint32_t unPoseStructSize)
 		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-
-			if (m_deviceMode == 5)
+			PROFILE_ZONE("DeviceManipulationHandle::handlePoseUpdate");
+			if (m_deviceMode.load(std::memory_order_acquire) == 5)
 			{ // motion compensation mode
 				auto serverDriver = ServerDriver::getInstance();
 				if (serverDriver)
@@ -42,22 +34,24 @@ namespace vrinputemulator
 					if (newPose.poseIsValid && newPose.result == vr::TrackingResult_Running_OK)
 					{
 						m_motionCompensationManager._setMotionCompensationStatus(MotionCompensationStatus::Running);
-						if (!m_motionCompensationManager._isMotionCompensationZeroPoseValid())
+						if (!m_motionCompensationManager._isMotionCompensationZeroPoseValid(this))
 						{
-							m_motionCompensationManager._setMotionCompensationZeroPose(newPose);
-							serverDriver->sendReplySetMotionCompensationMode(true);
+							if (m_motionCompensationManager._setMotionCompensationZeroPose(this, newPose))
+							{
+								serverDriver->sendReplySetMotionCompensationMode(m_openvrId, true);
+							}
 						}
 						else
 						{
-							m_motionCompensationManager._updateMotionCompensationRefPose(newPose);
+							m_motionCompensationManager._updateMotionCompensationRefPose(this, newPose);
 						}
 					}
 					else
 					{
-						if (!m_motionCompensationManager._isMotionCompensationZeroPoseValid())
+						if (!m_motionCompensationManager._isMotionCompensationZeroPoseValid(this))
 						{
-							setDefaultMode();
-							serverDriver->sendReplySetMotionCompensationMode(false);
+							// the next RunFrame puts the device back into default mode, see IpcShmCommunicator::runFrame
+							serverDriver->sendReplySetMotionCompensationMode(m_openvrId, false);
 						}
 						else
 						{
@@ -77,6 +71,27 @@ namespace vrinputemulator
 			}
 		}
 
+		void DeviceManipulationHandle::updateMotionCompensationConfig(const MotionCompensationConfig& config)
+		{
+			if (config.generation != m_motionCompensationConfig.generation)
+			{
+				bool modeChanged = config.velAccMode != m_motionCompensationConfig.velAccMode;
+				if (modeChanged || config.filterResetCount != m_motionCompensationConfig.filterResetCount)
+				{
+					m_lastPoseTime = -1;
+				}
+				m_kalmanFilter.setProcessNoise(config.kalmanProcessVariance);
+				m_kalmanFilter.setObservationNoise(config.kalmanObservationVariance);
+				m_rotKalmanFilter.setProcessNoise(config.rotKalmanProcessVariance);
+				m_rotKalmanFilter.setObservationNoise(config.rotKalmanObservationVariance);
+				if (modeChanged || config.movingAverageWindow != m_motionCompensationConfig.movingAverageWindow)
+				{
+					m_velMovingAverageBuffer.resize(config.movingAverageWindow);
+				}
+				m_motionCompensationConfig = config;
+			}
+		}
+
 		void DeviceManipulationHandle::ll_sendPoseUpdate(const vr::DriverPose_t& newPose)
 		{
 			if (m_deviceDriverInterfaceVersion == 4)
@@ -93,32 +108,13 @@ namespace vrinputemulator
 		{
 		}
 
-		bool _matchInputComponentName(const char* name, std::string& segment0, std::string& segment1, std::string& segment2, std::string& segment3)
-		{
-			boost::regex rgx("^/([^/]*)(/([^/]*))?(/([^/]*))?(/([^/]*))?");
-			boost::smatch match;
-			std::string text(name);
-			if (boost::regex_search(text, match, rgx))
-			{
-				segment0 = match[1];
-				segment1 = match[3];
-				segment2 = match[5];
-				segment3 = match[7];
-				return true;
-			}
-			else
-			{
-				return false;
-			}
-		}
-
 		int DeviceManipulationHandle::setDefaultMode()
 		{
 			std::lock_guard<std::recursive_mutex> lock(_mutex);
 			auto res = _disableOldMode(0);
 			if (res == 0)
 			{
-				m_deviceMode = 0;
+				_setDeviceMode(0);
 			}
 			return 0;
 		}
@@ -133,11 +129,34 @@ namespace vrinputemulator
 				m_motionCompensationManager.enableMotionCompensation(true);
 				m_motionCompensationManager.setMotionCompensationRefDevice(this);
 				m_motionCompensationManager._setMotionCompensationStatus(MotionCompensationStatus::WaitingForZeroRef);
-				m_deviceMode = 5;
+				_setDeviceMode(5);
 			}
 			return 0;
 		}
 
+		void DeviceManipulationHandle::_setDeviceMode(int newMode)
+		{
+			if (m_deviceMode.exchange(newMode) != newMode)
+			{
+				auto serverDriver = ServerDriver::getInstance();
+				if (serverDriver)
+				{
+					auto stats = serverDriver->deviceStats(m_openvrId);
+					if (stats)
+					{
+						stats->deviceMode.store(newMode, std::memory_order_relaxed);
+					}
+					DriverEvent event = {};
+					event.type = DriverEventType::DeviceModeChanged;
+					event.deviceId = m_openvrId;
+					event.deviceClass = m_eDeviceClass;
+					event.deviceMode = newMode;
+					event.motionCompensationStatus = m_motionCompensationManager.motionCompensationStatus();
+					serverDriver->publishDriverEvent(event);
+				}
+			}
+		}
+
 		int DeviceManipulationHandle::_disableOldMode(int newMode)
 		{
 			if (m_deviceMode != newMode)
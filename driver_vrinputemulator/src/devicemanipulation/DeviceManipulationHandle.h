@@ -1,9 +1,11 @@
 #pragma once
-#pragma once
 
 #include <openvr_driver.h>
 #include <vrinputemulator_types.h>
 #include <openvr_math.h>
+#include <atomic>
+#include <mutex>
+#include "MotionCompensationManager.h"
 #include "utils/KalmanFilter.h"
 #include "utils/MovingAverageRingBuffer.h"
 #include "../logging.h"
@@ -40,7 +42,7 @@ namespace vrinputemulator
 			std::shared_ptr<InterfaceHooks> m_serverDriverHooks;
 			std::shared_ptr<InterfaceHooks> m_controllerComponentHooks;
 
-			int m_deviceMode = 0; // 0 .. default, 1 .. disabled, 2 .. redirect source, 3 .. redirect target, 4 .. swap mode, 5 .. motion compensation
+			std::atomic<int> m_deviceMode = { 0 }; // 0 .. default, 1 .. disabled, 2 .. redirect source, 3 .. redirect target, 4 .. swap mode, 5 .. motion compensation
 			bool _disconnectedMsgSend = false;
 
 			bool m_offsetsEnabled = false;
@@ -51,16 +53,19 @@ namespace vrinputemulator
 			vr::HmdQuaternion_t m_deviceRotationOffset = { 1.0, 0.0, 0.0, 0.0 };
 			vr::HmdVector3d_t m_deviceTranslationOffset = { 0.0, 0.0, 0.0 };
 
-			long long m_lastPoseTime = -1;
+			long long m_lastPoseTime = -1; // see MonotonicClock, -1 .. no previous pose
 			bool m_lastPoseValid = false;
 			vr::DriverPose_t m_lastPose;
 			MovingAverageRingBuffer m_velMovingAverageBuffer;
 			double m_lastPoseTimeOffset = 0.0;
 			PosKalmanFilter m_kalmanFilter;
+			RotKalmanFilter m_rotKalmanFilter;
+			MotionCompensationConfig m_motionCompensationConfig; // last config applied to the filters above (only touched by the pose thread)
 
 			vr::PropertyContainerHandle_t m_propertyContainerHandle = vr::k_ulInvalidPropertyContainer;
 
 			int _disableOldMode(int newMode);
+			void _setDeviceMode(int newMode);
 
 		public:
 			DeviceManipulationHandle(const char* serial, vr::ETrackedDeviceClass eDeviceClass, void* driverPtr, void* driverHostPtr, int driverInterfaceVersion);
@@ -172,10 +177,15 @@ namespace vrinputemulator
 
 			bool handlePoseUpdate(uint32_t& unWhichDevice, vr::DriverPose_t& newPose, uint32_t unPoseStructSize);
 
+			void updateMotionCompensationConfig(const MotionCompensationConfig& config);
 			PosKalmanFilter& kalmanFilter()
 			{
 				return m_kalmanFilter;
 			}
+			RotKalmanFilter& rotKalmanFilter()
+			{
+				return m_rotKalmanFilter;
+			}
 			MovingAverageRingBuffer& velMovingAverage()
 			{
 				return m_velMovingAverageBuffer;
@@ -12,21 +12,21 @@ namespace vrinputemulator
 		void MotionCompensationManager::enableMotionCompensation(bool enable)
 		{
 			_motionCompensationZeroRefTimeout = 0;
-			_motionCompensationZeroPoseValid = false;
-			_motionCompensationRefPoseValid = false;
+			_refPoseSession.fetch_add(1, std::memory_order_acq_rel);
 			_motionCompensationEnabled = enable;
-			if (_motionCompensationVelAccMode == MotionCompensationVelAccMode::KalmanFilter)
+			std::lock_guard<std::mutex> lock(_configMutex);
+			if (_configWriterCopy.velAccMode == MotionCompensationVelAccMode::KalmanFilter)
 			{
-				m_parent->executeCodeForEachDeviceManipulationHandle([](DeviceManipulationHandle* handle)
-																	 {
-																		 handle->setLastPoseTime(-1);
-																	 });
+				_configWriterCopy.filterResetCount++;
+				_publishConfig();
 			}
 		}
 
 		void MotionCompensationManager::setMotionCompensationRefDevice(DeviceManipulationHandle* device)
 		{
+			// frames the old device publishes from now on still carry the old session and are ignored by the readers
 			_motionCompensationRefDevice = device;
+			_refPoseSession.fetch_add(1, std::memory_order_acq_rel);
 		}
 
 		DeviceManipulationHandle* MotionCompensationManager::getMotionCompensationRefDevice()
@@ -36,53 +36,83 @@ namespace vrinputemulator
 
 		void MotionCompensationManager::setMotionCompensationVelAccMode(MotionCompensationVelAccMode velAccMode)
 		{
-			if (_motionCompensationVelAccMode != velAccMode)
+			std::lock_guard<std::mutex> lock(_configMutex);
+			if (_configWriterCopy.velAccMode != velAccMode)
 			{
-				_motionCompensationRefVelAccValid = false;
-				m_parent->executeCodeForEachDeviceManipulationHandle([this](DeviceManipulationHandle* handle)
-																	 {
-																		 handle->setLastPoseTime(-1);
-																		 handle->kalmanFilter().setProcessNoise(m_motionCompensationKalmanProcessVariance);
-																		 handle->kalmanFilter().setObservationNoise(m_motionCompensationKalmanObservationVariance);
-																		 handle->velMovingAverage().resize(m_motionCompensationMovingAverageWindow);
-																	 });
-				_motionCompensationVelAccMode = velAccMode;
+				_configWriterCopy.velAccMode = velAccMode;
+				_publishConfig();
 			}
 		}
 
 		void MotionCompensationManager::setMotionCompensationKalmanProcessVariance(double variance)
 		{
-			m_motionCompensationKalmanProcessVariance = variance;
-			if (_motionCompensationVelAccMode == MotionCompensationVelAccMode::KalmanFilter)
-			{
-				m_parent->executeCodeForEachDeviceManipulationHandle([variance](DeviceManipulationHandle* handle)
-																	 {
-																		 handle->kalmanFilter().setProcessNoise(variance);
-																	 });
-			}
+			std::lock_guard<std::mutex> lock(_configMutex);
+			_configWriterCopy.kalmanProcessVariance = variance;
+			_publishConfig();
 		}
 
 		void MotionCompensationManager::setMotionCompensationKalmanObservationVariance(double variance)
 		{
-			m_motionCompensationKalmanObservationVariance = variance;
-			if (_motionCompensationVelAccMode == MotionCompensationVelAccMode::KalmanFilter)
-			{
-				m_parent->executeCodeForEachDeviceManipulationHandle([variance](DeviceManipulationHandle* handle)
-																	 {
-																		 handle->kalmanFilter().setObservationNoise(variance);
-																	 });
-			}
+			std::lock_guard<std::mutex> lock(_configMutex);
+			_configWriterCopy.kalmanObservationVariance = variance;
+			_publishConfig();
+		}
+
+		void MotionCompensationManager::setMotionCompensationRotKalmanVariances(double processVariance, double observationVariance)
+		{
+			std::lock_guard<std::mutex> lock(_configMutex);
+			_configWriterCopy.rotKalmanProcessVariance = processVariance;
+			_configWriterCopy.rotKalmanObservationVariance = observationVariance;
+			_publishConfig();
 		}
 
 		void MotionCompensationManager::setMotionCompensationMovingAverageWindow(unsigned window)
 		{
-			m_motionCompensationMovingAverageWindow = window;
-			if (_motionCompensationVelAccMode == MotionCompensationVelAccMode::LinearApproximation)
+			std::lock_guard<std::mutex> lock(_configMutex);
+			_configWriterCopy.movingAverageWindow = window;
+			_publishConfig();
+		}
+
+		void MotionCompensationManager::setMotionCompensationRefPosePrediction(bool enable, double maxPrediction)
+		{
+			std::lock_guard<std::mutex> lock(_configMutex);
+			_configWriterCopy.refPosePrediction = enable;
+			_configWriterCopy.refPosePredictionMax = maxPrediction;
+			_publishConfig();
+		}
+
+		void MotionCompensationManager::applyMotionCompensationConfig(MotionCompensationVelAccMode velAccMode, double kalmanProcessVariance, double kalmanObservationVariance,
+																	 double rotKalmanProcessVariance, double rotKalmanObservationVariance, unsigned movingAverageWindow)
+		{
+			std::lock_guard<std::mutex> lock(_configMutex);
+			_configWriterCopy.velAccMode = velAccMode;
+			_configWriterCopy.kalmanProcessVariance = kalmanProcessVariance;
+			_configWriterCopy.kalmanObservationVariance = kalmanObservationVariance;
+			_configWriterCopy.rotKalmanProcessVariance = rotKalmanProcessVariance;
+			_configWriterCopy.rotKalmanObservationVariance = rotKalmanObservationVariance;
+			_configWriterCopy.movingAverageWindow = movingAverageWindow;
+			_publishConfig();
+		}
+
+		// Must be called with _configMutex held (or from the constructor).
+		// Devices pick up the new snapshot with their next pose update, see DeviceManipulationHandle::updateMotionCompensationConfig.
+		void MotionCompensationManager::_publishConfig()
+		{
+			_configWriterCopy.generation++;
+			_config.store(_configWriterCopy);
+		}
+
+		// Called from pose threads on every pose, so the common case (no change) must stay a plain load.
+		// Publishing an event may block, so that is left to runFrame().
+		void MotionCompensationManager::_setMotionCompensationStatus(MotionCompensationStatus status)
+		{
+			if (_motionCompensationStatus.load(std::memory_order_relaxed) != status && _motionCompensationStatus.exchange(status) != status)
 			{
-				m_parent->executeCodeForEachDeviceManipulationHandle([window](DeviceManipulationHandle* handle)
-																	 {
-																		 handle->velMovingAverage().resize(window);
-																	 });
+				auto stats = m_parent->stats();
+				if (stats)
+				{
+					stats->motionCompensationStatus.store((uint32_t)status, std::memory_order_relaxed);
+				}
 			}
 		}
 
@@ -97,70 +127,222 @@ namespace vrinputemulator
 																 });
 		}
 
-		bool MotionCompensationManager::_isMotionCompensationZeroPoseValid()
+		// Claims the reference pose writer for the given device. Returns false (and drops the update) when the device is not the
+		// motion reference (anymore) or when another pose thread is still writing.
+		// Starts over with an empty reference frame when motion compensation has been (re-)enabled or the reference device changed.
+		bool MotionCompensationManager::_beginRefPoseUpdate(DeviceManipulationHandle* device)
+		{
+			if (_refPoseWriterBusy.test_and_set(std::memory_order_acquire))
+			{
+				return false;
+			}
+			// Session before device: setMotionCompensationRefDevice stores the device first, so a stale device always sees a stale session
+			auto session = _refPoseSession.load();
+			if (_motionCompensationRefDevice.load() != device)
+			{
+				_endRefPoseUpdate();
+				return false;
+			}
+			if (_refPoseWriterCopy.session != session || _refPoseWriterDevice != device)
+			{
+				_refPoseWriterCopy = MotionCompensationRefPose();
+				_refPoseWriterCopy.session = session;
+				_refPoseWriterDevice = device;
+			}
+			return true;
+		}
+
+		void MotionCompensationManager::_endRefPoseUpdate()
 		{
-			return _motionCompensationZeroPoseValid;
+			_refPoseWriterBusy.clear(std::memory_order_release);
 		}
 
-		void MotionCompensationManager::_setMotionCompensationZeroPose(const vr::DriverPose_t& pose)
+		// A device that cannot update the reference frame is treated as having a zero pose, it must not report a failure for the current reference device
+		bool MotionCompensationManager::_isMotionCompensationZeroPoseValid(DeviceManipulationHandle* device)
 		{
+			if (!_beginRefPoseUpdate(device))
+			{
+				return true;
+			}
+			auto valid = _refPoseWriterCopy.zeroPoseValid;
+			_endRefPoseUpdate();
+			return valid;
+		}
+
+		// Returns true when the zero pose has been captured
+		bool MotionCompensationManager::_setMotionCompensationZeroPose(DeviceManipulationHandle* device, const vr::DriverPose_t& pose)
+		{
+			if (!_beginRefPoseUpdate(device))
+			{
+				return false;
+			}
+			auto& ref = _refPoseWriterCopy;
+
 		// convert pose from driver space to app space
 			auto tmpConj = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
-			_motionCompensationZeroPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecPosition, true) - pose.vecWorldFromDriverTranslation;
-			_motionCompensationZeroRot = tmpConj * pose.qRotation;
+			ref.zeroPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecPosition, true) - pose.vecWorldFromDriverTranslation;
+			ref.zeroRot = tmpConj * pose.qRotation;
 
-			_motionCompensationZeroPoseValid = true;
+			ref.zeroPoseValid = true;
+			ref.refPoseValid = false;
+			ref.velAccValid = false;
+			_refPose.store(ref);
+			_endRefPoseUpdate();
+			return true;
 		}
 
-		void MotionCompensationManager::_updateMotionCompensationRefPose(const vr::DriverPose_t& pose)
+		void MotionCompensationManager::_updateMotionCompensationRefPose(DeviceManipulationHandle* device, const vr::DriverPose_t& pose)
 		{
+			if (!_beginRefPoseUpdate(device))
+			{
+				return;
+			}
+			auto& ref = _refPoseWriterCopy;
+
 		// convert pose from driver space to app space
 			auto tmpConj = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
-			_motionCompensationRefPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecPosition, true) - pose.vecWorldFromDriverTranslation;
+			ref.refPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecPosition, true) - pose.vecWorldFromDriverTranslation;
 			auto poseWorldRot = tmpConj * pose.qRotation;
 
 			// calculate orientation difference and its inverse
-			_motionCompensationRotDiff = poseWorldRot * vrmath::quaternionConjugate(_motionCompensationZeroRot);
-			_motionCompensationRotDiffInv = vrmath::quaternionConjugate(_motionCompensationRotDiff);
+			ref.rotDiff = poseWorldRot * vrmath::quaternionConjugate(ref.zeroRot);
+			ref.rotDiffInv = vrmath::quaternionConjugate(ref.rotDiff);
+
+			_updateCompensationTransform(ref);
+
+			// Linear and angular velocity in app space, used to extrapolate the reference pose to the time of the compensated poses
+			auto driverRot = vrmath::rotationMatrixFromQuaternion(pose.qWorldFromDriverRotation);
+			ref.refVel = vrmath::matMul33(pose.vecVelocity, driverRot);
+			ref.refAngVel = vrmath::matMul33(pose.vecAngularVelocity, driverRot);
+			ref.refPoseTime = MonotonicClock::now();
+			ref.refPoseTimeOffset = pose.poseTimeOffset;
 
 			// Convert velocity and acceleration values into app space and undo device rotation
-			if (_motionCompensationVelAccMode == MotionCompensationVelAccMode::SubstractMotionRef)
+			if (_config.load().velAccMode == MotionCompensationVelAccMode::SubstractMotionRef)
 			{
 				auto tmpRot = tmpConj * vrmath::quaternionConjugate(pose.qRotation);
-				auto tmpRotInv = vrmath::quaternionConjugate(tmpRot);
-				_motionCompensationRefPosVel = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, { pose.vecVelocity[0], pose.vecVelocity[1], pose.vecVelocity[2] });
-				_motionCompensationRefPosAcc = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, { pose.vecAcceleration[0], pose.vecAcceleration[1], pose.vecAcceleration[2] });
-				_motionCompensationRefRotVel = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, { pose.vecAngularVelocity[0], pose.vecAngularVelocity[1], pose.vecAngularVelocity[2] });
-				_motionCompensationRefRotAcc = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, { pose.vecAngularAcceleration[0], pose.vecAngularAcceleration[1], pose.vecAngularAcceleration[2] });
-				_motionCompensationRefVelAccValid = true;
+				vr::HmdVector3d_t velAcc[4] = {
+					{ pose.vecVelocity[0], pose.vecVelocity[1], pose.vecVelocity[2] },
+					{ pose.vecAcceleration[0], pose.vecAcceleration[1], pose.vecAcceleration[2] },
+					{ pose.vecAngularVelocity[0], pose.vecAngularVelocity[1], pose.vecAngularVelocity[2] },
+					{ pose.vecAngularAcceleration[0], pose.vecAngularAcceleration[1], pose.vecAngularAcceleration[2] }
+				};
+				vrmath::quaternionRotateVectors(tmpRot, velAcc, ref.refVelAcc, 4);
+				ref.velAccValid = true;
+			}
+			else
+			{
+				ref.velAccValid = false;
 			}
 
-			_motionCompensationRefPoseValid = true;
+			ref.refPoseValid = true;
+			_refPose.store(ref);
+
+			MotionCompensationRefSample sample;
+			sample.session = ref.session;
+			sample.time = ref.refPoseTime + MonotonicClock::fromSeconds(ref.refPoseTimeOffset);
+			sample.refPos = ref.refPos;
+			sample.rotDiff = ref.rotDiff;
+			// arrival time + poseTimeOffset can go backwards, such samples are dropped and the lookup falls back to extrapolation
+			_refPoseHistory.push(sample);
+			_endRefPoseUpdate();
+		}
+
+		// fold zero pose, reference position and rotation difference into one rigid transform
+		void MotionCompensationManager::_updateCompensationTransform(MotionCompensationRefPose& ref)
+		{
+			ref.compensationRot = vrmath::rotationMatrixFromQuaternion(ref.rotDiffInv);
+			ref.compensationTrans = ref.zeroPos - vrmath::matMul33(ref.compensationRot, ref.refPos);
+		}
+
+		// Moves the reference pose tdiff seconds ahead, assuming constant linear and angular velocity
+		void MotionCompensationManager::_extrapolateRefPose(MotionCompensationRefPose& ref, double tdiff)
+		{
+			ref.refPos = ref.refPos + ref.refVel * tdiff;
+			auto angVel = std::sqrt(ref.refAngVel.v[0] * ref.refAngVel.v[0] + ref.refAngVel.v[1] * ref.refAngVel.v[1] + ref.refAngVel.v[2] * ref.refAngVel.v[2]);
+			if (angVel > 1e-9)
+			{
+				auto axis = ref.refAngVel / angVel;
+				ref.rotDiff = vrmath::quaternionFromRotationAxis(angVel * tdiff, axis.v[0], axis.v[1], axis.v[2]) * ref.rotDiff;
+				ref.rotDiffInv = vrmath::quaternionConjugate(ref.rotDiff);
+			}
+			_updateCompensationTransform(ref);
+		}
+
+		// Replaces the reference pose with the one valid at the given time, interpolated between the two enclosing history samples.
+		// Returns false when the history does not cover the given time.
+		bool MotionCompensationManager::_interpolateRefPose(MotionCompensationRefPose& ref, long long time)
+		{
+			MotionCompensationRefSample before, after;
+			if (_refPoseHistory.lookup(time, before, after) != 2 || before.session != ref.session || after.session != ref.session)
+			{
+				return false;
+			}
+			double t = (double)(time - before.time) / (double)(after.time - before.time);
+			ref.refPos = before.refPos + (after.refPos - before.refPos) * t;
+			ref.rotDiff = vrmath::quaternionSlerp(before.rotDiff, after.rotDiff, t);
+			ref.rotDiffInv = vrmath::quaternionConjugate(ref.rotDiff);
+			_updateCompensationTransform(ref);
+			return true;
 		}
 
 		bool MotionCompensationManager::_applyMotionCompensation(vr::DriverPose_t& pose, DeviceManipulationHandle* deviceInfo)
 		{
-			if (_motionCompensationEnabled && _motionCompensationZeroPoseValid && _motionCompensationRefPoseValid)
+			PROFILE_ZONE("MotionCompensationManager::_applyMotionCompensation");
+			MotionCompensationRefPose ref;
+			if (_motionCompensationEnabled)
+			{
+				_refPose.load(ref);
+			}
+			if (_motionCompensationEnabled && ref.session == _refPoseSession.load(std::memory_order_acquire) && ref.zeroPoseValid && ref.refPoseValid)
 			{
+				MotionCompensationConfig config;
+				_config.load(config);
+				deviceInfo->updateMotionCompensationConfig(config);
+
+				auto now = MonotonicClock::now();
+				auto stats = m_parent->deviceStats(deviceInfo->openvrId());
+				auto poseTime = now + MonotonicClock::fromSeconds(pose.poseTimeOffset);
+				auto refPoseTime = ref.refPoseTime + MonotonicClock::fromSeconds(ref.refPoseTimeOffset);
+				if (poseTime < refPoseTime)
+				{
+				// This pose has been sampled before the latest reference pose, use the reference pose from that time
+					_interpolateRefPose(ref, poseTime);
+				}
+				else if (config.refPosePrediction)
+				{
+				// The reference device reports at a lower rate than most consumers, bring its pose to the time of this pose
+					double tdiff = MonotonicClock::toSeconds(poseTime - refPoseTime);
+					if (tdiff > config.refPosePredictionMax)
+					{
+						tdiff = config.refPosePredictionMax;
+					}
+					if (tdiff > 0.0)
+					{
+						_extrapolateRefPose(ref, tdiff);
+					}
+				}
+
 // convert pose from driver space to app space
+				// (the transposed driver rotation matrix undoes the driver rotation, it is reused below to convert back)
 				vr::HmdQuaternion_t tmpConj = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
-				auto poseWorldPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecPosition, true) - pose.vecWorldFromDriverTranslation;
+				auto driverRot = vrmath::rotationMatrixFromQuaternion(pose.qWorldFromDriverRotation);
+				auto poseWorldPos = vrmath::matMul33(pose.vecPosition, driverRot) - pose.vecWorldFromDriverTranslation;
 				auto poseWorldRot = tmpConj * pose.qRotation;
 
 				// do motion compensation
-				auto compensatedPoseWorldPos = _motionCompensationZeroPos + vrmath::quaternionRotateVector(_motionCompensationRotDiff, _motionCompensationRotDiffInv, poseWorldPos - _motionCompensationRefPos, true);
-				auto compensatedPoseWorldRot = _motionCompensationRotDiffInv * poseWorldRot;
+				auto compensatedPoseWorldPos = vrmath::matMul33(ref.compensationRot, poseWorldPos) + ref.compensationTrans;
+				auto compensatedPoseWorldRot = ref.rotDiffInv * poseWorldRot;
 
 				// Velocity / Acceleration Compensation
-				vr::HmdVector3d_t compensatedPoseWorldVel;
-				bool compensatedPoseWorldVelValid = false;
+				vr::HmdVector3d_t compensatedPoseWorldVelAcc[4]; // velocity, acceleration, angular velocity, angular acceleration
+				bool compensatedPoseWorldVelAccValid = false;
 				bool setVelToZero = false;
 				bool setAccToZero = false;
 				bool setAngVelToZero = false;
 				bool setAngAccToZero = false;
 
-				auto now = std::chrono::duration_cast <std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-				if (_motionCompensationVelAccMode == MotionCompensationVelAccMode::SetZero)
+				if (config.velAccMode == MotionCompensationVelAccMode::SetZero)
 				{
 					setVelToZero = true;
 					setAccToZero = true;
@@ -168,42 +350,42 @@ namespace vrinputemulator
 					setAngAccToZero = true;
 
 				}
-				else if (_motionCompensationVelAccMode == MotionCompensationVelAccMode::SubstractMotionRef)
+				else if (config.velAccMode == MotionCompensationVelAccMode::SubstractMotionRef)
 				{
 				// We translate the motion ref vel/acc values into driver space and directly substract them
-					if (_motionCompensationRefVelAccValid)
+					if (ref.velAccValid)
 					{
-						auto tmpRot = pose.qWorldFromDriverRotation * pose.qRotation;
-						auto tmpRotInv = vrmath::quaternionConjugate(tmpRot);
-						auto tmpPosVel = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, _motionCompensationRefPosVel);
-						pose.vecVelocity[0] -= tmpPosVel.v[0];
-						pose.vecVelocity[1] -= tmpPosVel.v[1];
-						pose.vecVelocity[2] -= tmpPosVel.v[2];
-						auto tmpPosAcc = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, _motionCompensationRefPosAcc);
-						pose.vecAcceleration[0] -= tmpPosAcc.v[0];
-						pose.vecAcceleration[1] -= tmpPosAcc.v[1];
-						pose.vecAcceleration[2] -= tmpPosAcc.v[2];
-						auto tmpRotVel = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, _motionCompensationRefRotVel);
-						pose.vecAngularVelocity[0] -= tmpRotVel.v[0];
-						pose.vecAngularVelocity[1] -= tmpRotVel.v[1];
-						pose.vecAngularVelocity[2] -= tmpRotVel.v[2];
-						auto tmpRotAcc = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, _motionCompensationRefRotAcc);
-						pose.vecAngularAcceleration[0] -= tmpRotAcc.v[0];
-						pose.vecAngularAcceleration[1] -= tmpRotAcc.v[1];
-						pose.vecAngularAcceleration[2] -= tmpRotAcc.v[2];
+						vr::HmdVector3d_t tmpVelAcc[4];
+						vrmath::quaternionRotateVectors(pose.qWorldFromDriverRotation * pose.qRotation, ref.refVelAcc, tmpVelAcc, 4);
+						pose.vecVelocity[0] -= tmpVelAcc[0].v[0];
+						pose.vecVelocity[1] -= tmpVelAcc[0].v[1];
+						pose.vecVelocity[2] -= tmpVelAcc[0].v[2];
+						pose.vecAcceleration[0] -= tmpVelAcc[1].v[0];
+						pose.vecAcceleration[1] -= tmpVelAcc[1].v[1];
+						pose.vecAcceleration[2] -= tmpVelAcc[1].v[2];
+						pose.vecAngularVelocity[0] -= tmpVelAcc[2].v[0];
+						pose.vecAngularVelocity[1] -= tmpVelAcc[2].v[1];
+						pose.vecAngularVelocity[2] -= tmpVelAcc[2].v[2];
+						pose.vecAngularAcceleration[0] -= tmpVelAcc[3].v[0];
+						pose.vecAngularAcceleration[1] -= tmpVelAcc[3].v[1];
+						pose.vecAngularAcceleration[2] -= tmpVelAcc[3].v[2];
 					}
 
 				}
-				else if (_motionCompensationVelAccMode == MotionCompensationVelAccMode::KalmanFilter)
+				else if (config.velAccMode == MotionCompensationVelAccMode::KalmanFilter)
 				{
 				// The Kalman filter uses app space coordinates
 					auto lastTime = deviceInfo->getLastPoseTime();
 					if (lastTime >= 0.0)
 					{
-						double tdiff = ((double)(now - lastTime) / 1.0E6) + (pose.poseTimeOffset - deviceInfo->getLastPoseTimeOffset());
+						double tdiff = MonotonicClock::toSeconds(now - lastTime) + (pose.poseTimeOffset - deviceInfo->getLastPoseTimeOffset());
 						if (tdiff < 0.0001)
 						{ // Sometimes we get a very small or even negative time difference between current and last pose
 						   // In this case we just take the velocities and accelerations from last time
+							if (stats)
+							{
+								stats->add(stats->velAccFallbackCount, 1);
+							}
 							auto& lastPose = deviceInfo->lastDriverPose();
 							pose.vecVelocity[0] = lastPose.vecVelocity[0];
 							pose.vecVelocity[1] = lastPose.vecVelocity[1];
@@ -221,24 +403,27 @@ namespace vrinputemulator
 						else
 						{
 							deviceInfo->kalmanFilter().update(compensatedPoseWorldPos, tdiff);
+							deviceInfo->rotKalmanFilter().update(compensatedPoseWorldRot, tdiff);
+							if (stats)
+							{
+								stats->setKalmanInnovation(deviceInfo->kalmanFilter().getLastInnovation());
+							}
 							//compensatedPoseWorldPos = deviceInfo->kalmanFilter().getUpdatedPositionEstimate(); // Better to use the original values
-							compensatedPoseWorldVel = deviceInfo->kalmanFilter().getUpdatedVelocityEstimate();
-							compensatedPoseWorldVelValid = true;
-							// Kalman filter only gives us velocity, so set the rest to zero
-							setAccToZero = true;
-							setAngVelToZero = true;
-							setAngAccToZero = true;
+							compensatedPoseWorldVelAcc[0] = deviceInfo->kalmanFilter().getUpdatedVelocityEstimate();
+							compensatedPoseWorldVelAcc[1] = deviceInfo->kalmanFilter().getUpdatedAccelerationEstimate();
+							compensatedPoseWorldVelAcc[2] = deviceInfo->rotKalmanFilter().getUpdatedAngularVelocityEstimate();
+							compensatedPoseWorldVelAcc[3] = deviceInfo->rotKalmanFilter().getUpdatedAngularAccelerationEstimate();
+							compensatedPoseWorldVelAccValid = true;
 						}
 					}
 					else
 					{
-						deviceInfo->kalmanFilter().init(
-							compensatedPoseWorldPos,
-							{ 0.0, 0.0, 0.0 },
-							{ { 0.0, 0.0 },{ 0.0, 0.0 } }
-						);
-						deviceInfo->kalmanFilter().setProcessNoise(m_motionCompensationKalmanProcessVariance);
-						deviceInfo->kalmanFilter().setObservationNoise(m_motionCompensationKalmanObservationVariance);
+						deviceInfo->kalmanFilter().init(compensatedPoseWorldPos, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, 0.0);
+						deviceInfo->kalmanFilter().setProcessNoise(config.kalmanProcessVariance);
+						deviceInfo->kalmanFilter().setObservationNoise(config.kalmanObservationVariance);
+						deviceInfo->rotKalmanFilter().init(compensatedPoseWorldRot, 0.0);
+						deviceInfo->rotKalmanFilter().setProcessNoise(config.rotKalmanProcessVariance);
+						deviceInfo->rotKalmanFilter().setObservationNoise(config.rotKalmanObservationVariance);
 						// Kalman Filter is not ready yet, so set everything to zero
 						setVelToZero = true;
 						setAccToZero = true;
@@ -247,16 +432,20 @@ namespace vrinputemulator
 					}
 
 				}
-				else if (_motionCompensationVelAccMode == MotionCompensationVelAccMode::LinearApproximation)
+				else if (config.velAccMode == MotionCompensationVelAccMode::LinearApproximation)
 				{
 				// Linear approximation uses driver space coordinates
 					if (deviceInfo->lastDriverPoseValid())
 					{
 						auto& lastPose = deviceInfo->lastDriverPose();
-						double tdiff = ((double)(now - deviceInfo->getLastPoseTime()) / 1.0E6) + (pose.poseTimeOffset - lastPose.poseTimeOffset);
+						double tdiff = MonotonicClock::toSeconds(now - deviceInfo->getLastPoseTime()) + (pose.poseTimeOffset - lastPose.poseTimeOffset);
 						if (tdiff < 0.0001)
 						{ // Sometimes we get a very small or even negative time difference between current and last pose
 						   // In this case we just take the velocities and accelerations from last time
+							if (stats)
+							{
+								stats->add(stats->velAccFallbackCount, 1);
+							}
 							pose.vecVelocity[0] = lastPose.vecVelocity[0];
 							pose.vecVelocity[1] = lastPose.vecVelocity[1];
 							pose.vecVelocity[2] = lastPose.vecVelocity[2];
@@ -313,16 +502,20 @@ namespace vrinputemulator
 
 				// convert back to driver space
 				pose.qRotation = pose.qWorldFromDriverRotation * compensatedPoseWorldRot;
-				auto adjPoseDriverPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, compensatedPoseWorldPos + pose.vecWorldFromDriverTranslation);
+				auto adjPoseDriverPos = vrmath::matMul33(driverRot, compensatedPoseWorldPos + pose.vecWorldFromDriverTranslation);
 				pose.vecPosition[0] = adjPoseDriverPos.v[0];
 				pose.vecPosition[1] = adjPoseDriverPos.v[1];
 				pose.vecPosition[2] = adjPoseDriverPos.v[2];
-				if (compensatedPoseWorldVelValid)
+				if (compensatedPoseWorldVelAccValid)
 				{
-					auto adjPoseDriverVel = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, compensatedPoseWorldVel);
-					pose.vecVelocity[0] = adjPoseDriverVel.v[0];
-					pose.vecVelocity[1] = adjPoseDriverVel.v[1];
-					pose.vecVelocity[2] = adjPoseDriverVel.v[2];
+					vrmath::matMul33(driverRot, compensatedPoseWorldVelAcc, compensatedPoseWorldVelAcc, 4);
+					for (unsigned i = 0; i < 3; i++)
+					{
+						pose.vecVelocity[i] = compensatedPoseWorldVelAcc[0].v[i];
+						pose.vecAcceleration[i] = compensatedPoseWorldVelAcc[1].v[i];
+						pose.vecAngularVelocity[i] = compensatedPoseWorldVelAcc[2].v[i];
+						pose.vecAngularAcceleration[i] = compensatedPoseWorldVelAcc[3].v[i];
+					}
 				}
 				else if (setVelToZero)
 				{
@@ -360,13 +553,28 @@ namespace vrinputemulator
 
 		void MotionCompensationManager::runFrame()
 		{
+			// status changes between two frames are coalesced, clients only need the latest one
+			auto status = _motionCompensationStatus.load();
+			if (status != _publishedMotionCompensationStatus)
+			{
+				_publishedMotionCompensationStatus = status;
+				DriverEvent event = {};
+				event.type = DriverEventType::MotionCompensationStatusChanged;
+				event.deviceId = vr::k_unTrackedDeviceIndexInvalid;
+				event.motionCompensationStatus = status;
+				m_parent->publishDriverEvent(event);
+			}
 			if (_motionCompensationEnabled && _motionCompensationStatus == MotionCompensationStatus::WaitingForZeroRef)
 			{
 				_motionCompensationZeroRefTimeout++;
 				if (_motionCompensationZeroRefTimeout >= _motionCompensationZeroRefTimeoutMax)
 				{
-					_motionCompensationRefDevice->setDefaultMode();
-					m_parent->sendReplySetMotionCompensationMode(false);
+					auto refDevice = _motionCompensationRefDevice.load();
+					if (refDevice)
+					{
+						refDevice->setDefaultMode();
+						m_parent->sendReplySetMotionCompensationMode(refDevice->openvrId(), false);
+					}
 				}
 			}
 		}
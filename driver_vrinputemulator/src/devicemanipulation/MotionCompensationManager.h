@@ -3,6 +3,11 @@
 #include <openvr_driver.h>
 #include <vrinputemulator_types.h>
 #include <openvr_math.h>
+#include <monotonic_clock.h>
+#include <atomic>
+#include <mutex>
+#include "utils/SeqLock.h"
+#include "utils/SampleHistory.h"
 #include "../logging.h"
 
 
@@ -15,18 +20,64 @@ namespace vrinputemulator
 		class ServerDriver;
 		class DeviceManipulationHandle;
 
-		enum class MotionCompensationStatus : uint32_t
+		// Immutable snapshot of the motion compensation settings.
+		// Published by the ipc thread, consumed by the pose threads without locking.
+		struct MotionCompensationConfig
 		{
-			WaitingForZeroRef = 0,
-			Running = 1,
-			MotionRefNotTracking = 2
+			uint32_t generation = 0; // incremented on every change
+			uint32_t filterResetCount = 0; // incremented when all velocity filters need to start over
+			MotionCompensationVelAccMode velAccMode = MotionCompensationVelAccMode::Disabled;
+			double kalmanProcessVariance = 0.1;
+			double kalmanObservationVariance = 0.1;
+			// The rotation filter observes angular velocities (rad/s) obtained by differencing consecutive orientations,
+			// at ~1 kHz a fraction of a milliradian of orientation jitter already amounts to several tenths of a rad/s.
+			double rotKalmanProcessVariance = 10.0; // (rad/s^2)^2
+			double rotKalmanObservationVariance = 0.5; // (rad/s)^2
+			unsigned movingAverageWindow = 3;
+			bool refPosePrediction = false; // extrapolate the reference pose to the timestamp of each compensated pose
+			double refPosePredictionMax = 0.02; // seconds, larger gaps are only extrapolated up to this value
 		};
-		
+
+		// Reference frame all compensated devices are transformed against.
+		// Written by the pose thread of the motion reference device, consumed by the pose threads of all other devices.
+		struct MotionCompensationRefPose
+		{
+			uint32_t session = 0; // value of MotionCompensationManager::_refPoseSession this frame belongs to
+			bool zeroPoseValid = false;
+			bool refPoseValid = false;
+			bool velAccValid = false;
+			vr::HmdVector3d_t zeroPos;
+			vr::HmdQuaternion_t zeroRot;
+			vr::HmdVector3d_t refPos;
+			vr::HmdQuaternion_t rotDiff;
+			vr::HmdQuaternion_t rotDiffInv;
+			// compensated app space position = compensationRot * app space position + compensationTrans
+			// Precomputed with every reference update so that consumers only need a single matrix multiplication.
+			vrmath::Matrix33d compensationRot;
+			vr::HmdVector3d_t compensationTrans;
+			// needed to extrapolate the reference pose (app space)
+			long long refPoseTime = 0; // arrival time, see MonotonicClock
+			double refPoseTimeOffset = 0.0;
+			vr::HmdVector3d_t refVel;
+			vr::HmdVector3d_t refAngVel;
+			vr::HmdVector3d_t refVelAcc[4]; // velocity, acceleration, angular velocity, angular acceleration (rotated in one batch)
+		};
+
+		// One entry of the reference pose history, just enough to rebuild the compensation transform for a past point in time
+		struct MotionCompensationRefSample
+		{
+			uint32_t session = 0;
+			long long time = 0; // sample time (arrival time + poseTimeOffset), see MonotonicClock
+			vr::HmdVector3d_t refPos;
+			vr::HmdQuaternion_t rotDiff;
+		};
+
 		class MotionCompensationManager
 		{
 		public:
 			MotionCompensationManager(ServerDriver* parent) : m_parent(parent)
 			{
+				_publishConfig();
 			}
 
 			void enableMotionCompensation(bool enable);
@@ -34,63 +85,90 @@ namespace vrinputemulator
 			{
 				return _motionCompensationStatus;
 			}
-			void _setMotionCompensationStatus(MotionCompensationStatus status)
-			{
-				_motionCompensationStatus = status;
-			}
+			void _setMotionCompensationStatus(MotionCompensationStatus status);
 			void setMotionCompensationRefDevice(DeviceManipulationHandle* device);
 			DeviceManipulationHandle* getMotionCompensationRefDevice();
+			MotionCompensationConfig motionCompensationConfig() const
+			{
+				return _config.load();
+			}
 			void setMotionCompensationVelAccMode(MotionCompensationVelAccMode velAccMode);
 			double motionCompensationKalmanProcessVariance()
 			{
-				return m_motionCompensationKalmanProcessVariance;
+				return _config.load().kalmanProcessVariance;
 			}
 			void setMotionCompensationKalmanProcessVariance(double variance);
 			double motionCompensationKalmanObservationVariance()
 			{
-				return m_motionCompensationKalmanObservationVariance;
+				return _config.load().kalmanObservationVariance;
 			}
 			void setMotionCompensationKalmanObservationVariance(double variance);
+			double motionCompensationRotKalmanProcessVariance()
+			{
+				return _config.load().rotKalmanProcessVariance;
+			}
+			double motionCompensationRotKalmanObservationVariance()
+			{
+				return _config.load().rotKalmanObservationVariance;
+			}
+			void setMotionCompensationRotKalmanVariances(double processVariance, double observationVariance);
 			double motionCompensationMovingAverageWindow()
 			{
-				return m_motionCompensationMovingAverageWindow;
+				return _config.load().movingAverageWindow;
 			}
 			void setMotionCompensationMovingAverageWindow(unsigned window);
+			bool motionCompensationRefPosePrediction()
+			{
+				return _config.load().refPosePrediction;
+			}
+			void setMotionCompensationRefPosePrediction(bool enable, double maxPrediction);
+			// Sets all filter settings at once, pose threads see either the old or the new configuration
+			void applyMotionCompensationConfig(MotionCompensationVelAccMode velAccMode, double kalmanProcessVariance, double kalmanObservationVariance,
+											   double rotKalmanProcessVariance, double rotKalmanObservationVariance, unsigned movingAverageWindow);
 			void _disableMotionCompensationOnAllDevices();
-			bool _isMotionCompensationZeroPoseValid();
-			void _setMotionCompensationZeroPose(const vr::DriverPose_t& pose);
-			void _updateMotionCompensationRefPose(const vr::DriverPose_t& pose);
+			// Reference pose updates, only called from the pose thread of the given device.
+			// Updates from a device that is no longer the motion reference are dropped.
+			bool _isMotionCompensationZeroPoseValid(DeviceManipulationHandle* device);
+			bool _setMotionCompensationZeroPose(DeviceManipulationHandle* device, const vr::DriverPose_t& pose);
+			void _updateMotionCompensationRefPose(DeviceManipulationHandle* device, const vr::DriverPose_t& pose);
 			bool _applyMotionCompensation(vr::DriverPose_t& pose, DeviceManipulationHandle* deviceInfo);
 
 			void runFrame();
 
 		private:
+			void _publishConfig();
+			bool _beginRefPoseUpdate(DeviceManipulationHandle* device);
+			void _endRefPoseUpdate();
+			static void _updateCompensationTransform(MotionCompensationRefPose& ref);
+			static void _extrapolateRefPose(MotionCompensationRefPose& ref, double tdiff);
+			bool _interpolateRefPose(MotionCompensationRefPose& ref, long long time);
+
 			ServerDriver* m_parent;
 
-			bool _motionCompensationEnabled = false;
-			DeviceManipulationHandle* _motionCompensationRefDevice = nullptr;
-			MotionCompensationStatus _motionCompensationStatus = MotionCompensationStatus::WaitingForZeroRef;
+			std::atomic<bool> _motionCompensationEnabled = { false };
+			std::atomic<DeviceManipulationHandle*> _motionCompensationRefDevice = { nullptr };
+			std::atomic<MotionCompensationStatus> _motionCompensationStatus = { MotionCompensationStatus::WaitingForZeroRef };
+			MotionCompensationStatus _publishedMotionCompensationStatus = MotionCompensationStatus::WaitingForZeroRef; // only touched by runFrame()
 			constexpr static uint32_t _motionCompensationZeroRefTimeoutMax = 20;
 			uint32_t _motionCompensationZeroRefTimeout = 0;
-			MotionCompensationVelAccMode _motionCompensationVelAccMode = MotionCompensationVelAccMode::Disabled;
-			double m_motionCompensationKalmanProcessVariance = 0.1;
-			double m_motionCompensationKalmanObservationVariance = 0.1;
-			unsigned m_motionCompensationMovingAverageWindow = 3;
-
-			bool _motionCompensationZeroPoseValid = false;
-			vr::HmdVector3d_t _motionCompensationZeroPos;
-			vr::HmdQuaternion_t _motionCompensationZeroRot;
 
-			bool _motionCompensationRefPoseValid = false;
-			vr::HmdVector3d_t _motionCompensationRefPos;
-			vr::HmdQuaternion_t _motionCompensationRotDiff;
-			vr::HmdQuaternion_t _motionCompensationRotDiffInv;
+			// Settings: writers serialize on _configMutex and publish a new snapshot, pose threads only read the snapshot
+			std::mutex _configMutex;
+			MotionCompensationConfig _configWriterCopy;
+			SeqLock<MotionCompensationConfig> _config;
 
-			bool _motionCompensationRefVelAccValid = false;
-			vr::HmdVector3d_t _motionCompensationRefPosVel;
-			vr::HmdVector3d_t _motionCompensationRefPosAcc;
-			vr::HmdVector3d_t _motionCompensationRefRotVel;
-			vr::HmdVector3d_t _motionCompensationRefRotAcc;
+			// Reference pose: _refPoseWriterCopy is only touched by the pose thread of the motion reference device,
+			// every update is published as a whole so that readers never see a half-written frame.
+			// Bumping _refPoseSession invalidates all previously published frames.
+			// While the reference device changes the pose thread of the old device may still be running, so writers claim
+			// _refPoseWriterBusy (without waiting) and drop their update when they are not the current reference device.
+			std::atomic<uint32_t> _refPoseSession = { 0 };
+			std::atomic_flag _refPoseWriterBusy = ATOMIC_FLAG_INIT;
+			DeviceManipulationHandle* _refPoseWriterDevice = nullptr; // device _refPoseWriterCopy has been built from
+			MotionCompensationRefPose _refPoseWriterCopy;
+			SeqLock<MotionCompensationRefPose> _refPose;
+			// Recent reference poses, lets poses that were sampled before the latest reference update use the matching reference
+			SampleHistory<MotionCompensationRefSample, 16> _refPoseHistory;
 		};
 	}
 }
\ No newline at end of file
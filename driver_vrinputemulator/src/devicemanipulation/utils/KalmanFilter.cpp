@@ -1,63 +1,50 @@
 #include "KalmanFilter.h"
 
 #include <openvr_math.h>
+#include "../../driver/Profiler.h"
 
 
 namespace vrinputemulator
 {
 	namespace driver
 	{
-		void PosKalmanFilter::init(const vr::HmdVector3d_t& initPos, const vr::HmdVector3d_t& initVel, const double(&initCovariance)[2][2])
+		void PosKalmanFilter::init(const vr::HmdVector3d_t& initPos, const vr::HmdVector3d_t& initVel, const vr::HmdVector3d_t& initAcc, double initVariance)
 		{
-			lastPos = initPos;
-			lastVel = initVel;
-			lastCovariance[0][0] = initCovariance[0][0];
-			lastCovariance[0][1] = initCovariance[0][1];
-			lastCovariance[1][0] = initCovariance[1][0];
-			lastCovariance[1][1] = initCovariance[1][1];
+			const vr::HmdVector3d_t initState[3] = { initPos, initVel, initAcc };
+			filter.init(initState, initVariance);
 		}
 
 		void PosKalmanFilter::update(const vr::HmdVector3d_t& devicePos, double dt)
 		{
-			// predict new position
-			vr::HmdVector3d_t predictedPos = {
-				lastPos.v[0] + dt * lastVel.v[0],
-				lastPos.v[1] + dt * lastVel.v[1],
-				lastPos.v[2] + dt * lastVel.v[2]
-			};
-			// no need to predict new velocity: is equal to lastVel
-			// predict new covariance matrix
-			double newCovariance[2][2] = {
-				lastCovariance[0][0] + dt * (lastCovariance[0][1] + lastCovariance[1][0]) + dt * dt * lastCovariance[1][1] + 1.0 / 4.0 * pow(dt, 4.0) * processNoise,
-				lastCovariance[0][1] + dt * lastCovariance[1][1] + 1.0 / 2.0 * pow(dt, 3.0) * processNoise,
-				lastCovariance[1][0] + dt * lastCovariance[1][1] + 1.0 / 2.0 * pow(dt, 3.0) * processNoise,
-				lastCovariance[1][1] + dt * dt * processNoise
-			};
-			// calculate innovation
-			vr::HmdVector3d_t innovation = devicePos - predictedPos;
-			// calculate innovation variance
-			double innovationVariance = newCovariance[0][0] + observationNoise;
-			// calculate kalman gain
-			double gain[2];
-			if (innovationVariance == 0.0)
-			{
-				gain[0] = 1;
-				gain[1] = 1;
+			PROFILE_ZONE("PosKalmanFilter::update");
+			filter.update(devicePos, dt);
+		}
+
+		void RotKalmanFilter::init(const vr::HmdQuaternion_t& initRot, double initVariance)
+		{
+			lastRot = initRot;
+			const vr::HmdVector3d_t initState[2] = { { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+			filter.init(initState, initVariance);
+		}
+
+		void RotKalmanFilter::update(const vr::HmdQuaternion_t& deviceRot, double dt)
+		{
+			// rotation since the last update
+			auto delta = deviceRot * vrmath::quaternionConjugate(lastRot);
+			if (delta.w < 0.0)
+			{ // take the short way around
+				delta = { -delta.w, -delta.x, -delta.y, -delta.z };
 			}
-			else
+			// convert to axis-angle and divide by time to get the observed angular velocity
+			vr::HmdVector3d_t angVel = { 0.0, 0.0, 0.0 };
+			double sinHalfAngle = std::sqrt(delta.x * delta.x + delta.y * delta.y + delta.z * delta.z);
+			if (sinHalfAngle > 1e-12)
 			{
-				gain[0] = newCovariance[0][0] / innovationVariance;
-				gain[1] = newCovariance[1][0] / innovationVariance;
+				double angle = 2.0 * std::atan2(sinHalfAngle, delta.w);
+				angVel = vr::HmdVector3d_t{ delta.x, delta.y, delta.z } * (angle / (sinHalfAngle * dt));
 			}
-			// calculate new a posteriori position
-			lastPos = lastPos + innovation * gain[0];
-			// calculate new a posteriori velocity
-			lastVel = lastVel + innovation * gain[1];
-			// calculate new a posteriori covariance matrix
-			lastCovariance[0][0] = (1 - gain[0]) * newCovariance[0][0];
-			lastCovariance[0][1] = (1 - gain[0]) * newCovariance[0][1];
-			lastCovariance[1][0] = newCovariance[1][0] - gain[1] * newCovariance[0][0];
-			lastCovariance[1][1] = newCovariance[1][1] - gain[1] * newCovariance[0][1];
+			filter.update(angVel, dt);
+			lastRot = deviceRot;
 		}
 
 	}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <openvr_driver.h>
+#include <cmath>
 
 // driver namespace
 namespace vrinputemulator
@@ -8,39 +9,247 @@ namespace vrinputemulator
 	namespace driver
 	{
 
-		// Kalman filter to filter device positions (and get their velocity at the same time)
-		class PosKalmanFilter
+		// Kalman filter for three independent axes with a kinematic state of N values per axis
+		// (N = 2: value and 1st derivative, N = 3: value, 1st and 2nd derivative). Only the value itself is observed.
+		//
+		// Every axis has its own covariance matrix and noise parameters. All arrays are laid out structure-of-arrays with the axis as
+		// innermost index (padded to four lanes), so each step is a fixed-length loop over contiguous doubles that the compiler can vectorize.
+		// No heap allocations.
+		template<unsigned N>
+		class AxisKalmanFilter
 		{
+			static_assert(N == 2 || N == 3, "AxisKalmanFilter supports 2 or 3 states per axis");
+
+		public:
+			void init(const vr::HmdVector3d_t(&initState)[N], double initVariance)
+			{
+				for (unsigned i = 0; i < N; i++)
+				{
+					for (unsigned a = 0; a < Lanes; a++)
+					{
+						x[i][a] = a < 3 ? initState[i].v[a] : 0.0;
+						for (unsigned j = 0; j < N; j++)
+						{
+							P[i][j][a] = i == j ? initVariance : 0.0;
+						}
+					}
+				}
+			}
+
+			void setProcessNoise(double variance)
+			{
+				for (unsigned a = 0; a < Lanes; a++)
+				{
+					q[a] = variance;
+				}
+			}
+			void setProcessNoise(unsigned axis, double variance)
+			{
+				q[axis] = variance;
+			}
+			void setObservationNoise(double variance)
+			{
+				for (unsigned a = 0; a < Lanes; a++)
+				{
+					r[a] = variance;
+				}
+			}
+			void setObservationNoise(unsigned axis, double variance)
+			{
+				r[axis] = variance;
+			}
+
+			void update(const vr::HmdVector3d_t& observation, double dt)
+			{
+				// state transition: F[i][j] = dt^(j-i) / (j-i)!
+				// process noise enters as white noise on the highest derivative: Q = G * G^T * q with G[i] = dt^(N-i) / (N-i)!
+				double dtPow[N + 1] = { 1.0 };
+				for (unsigned i = 1; i <= N; i++)
+				{
+					dtPow[i] = dtPow[i - 1] * dt / i;
+				}
+				double F[N][N];
+				double G[N];
+				for (unsigned i = 0; i < N; i++)
+				{
+					for (unsigned j = 0; j < N; j++)
+					{
+						F[i][j] = j >= i ? dtPow[j - i] : 0.0;
+					}
+					G[i] = dtPow[N - i];
+				}
+
+				// predict state and covariance
+				double xp[N][Lanes];
+				double FP[N][N][Lanes];
+				double Pp[N][N][Lanes];
+				for (unsigned i = 0; i < N; i++)
+				{
+					for (unsigned a = 0; a < Lanes; a++)
+					{
+						xp[i][a] = 0.0;
+					}
+					for (unsigned k = i; k < N; k++)
+					{
+						for (unsigned a = 0; a < Lanes; a++)
+						{
+							xp[i][a] += F[i][k] * x[k][a];
+						}
+					}
+					for (unsigned j = 0; j < N; j++)
+					{
+						for (unsigned a = 0; a < Lanes; a++)
+						{
+							FP[i][j][a] = 0.0;
+						}
+						for (unsigned k = i; k < N; k++)
+						{
+							for (unsigned a = 0; a < Lanes; a++)
+							{
+								FP[i][j][a] += F[i][k] * P[k][j][a];
+							}
+						}
+					}
+				}
+				for (unsigned i = 0; i < N; i++)
+				{
+					for (unsigned j = 0; j < N; j++)
+					{
+						for (unsigned a = 0; a < Lanes; a++)
+						{
+							Pp[i][j][a] = G[i] * G[j] * q[a];
+						}
+						for (unsigned k = j; k < N; k++)
+						{
+							for (unsigned a = 0; a < Lanes; a++)
+							{
+								Pp[i][j][a] += FP[i][k][a] * F[j][k];
+							}
+						}
+					}
+				}
+
+				// innovation, kalman gain and a posteriori estimates
+				double z[Lanes] = { observation.v[0], observation.v[1], observation.v[2], 0.0 };
+				double y[Lanes];
+				double K[N][Lanes];
+				for (unsigned a = 0; a < Lanes; a++)
+				{
+					double s = Pp[0][0][a] + r[a];
+					y[a] = z[a] - xp[0][a];
+					for (unsigned i = 0; i < N; i++)
+					{
+						K[i][a] = s != 0.0 ? Pp[i][0][a] / s : 1.0;
+					}
+				}
+				innovation = std::sqrt(y[0] * y[0] + y[1] * y[1] + y[2] * y[2]);
+				for (unsigned i = 0; i < N; i++)
+				{
+					for (unsigned a = 0; a < Lanes; a++)
+					{
+						x[i][a] = xp[i][a] + K[i][a] * y[a];
+					}
+					for (unsigned j = 0; j < N; j++)
+					{
+						for (unsigned a = 0; a < Lanes; a++)
+						{
+							P[i][j][a] = Pp[i][j][a] - K[i][a] * Pp[0][j][a];
+						}
+					}
+				}
+			}
+
+			vr::HmdVector3d_t state(unsigned i) const
+			{
+				return { x[i][0], x[i][1], x[i][2] };
+			}
+
+			// length of the difference between the last observation and its prediction
+			double lastInnovation() const
+			{
+				return innovation;
+			}
+
 		private:
-			// last a posteriori state estimate
-			vr::HmdVector3d_t lastPos = { 0.0, 0.0, 0.0 };
-			vr::HmdVector3d_t lastVel = { 0.0, 0.0, 0.0 };
-			// last a posteriori estimate covariance matrix
-			double lastCovariance[2][2] = { 0.0, 0.0, 0.0, 0.0 };
+			static const unsigned Lanes = 4; // three axes plus padding
+
+			// a posteriori state estimate
+			double x[N][Lanes] = {};
+			// a posteriori estimate covariance matrices
+			double P[N][N][Lanes] = {};
 			// process noise variance
-			double processNoise = 0.0;
+			double q[Lanes] = {};
 			// observation noise variance
-			double observationNoise = 0.0;
+			double r[Lanes] = {};
+			double innovation = 0.0;
+		};
+
+
+		// Kalman filter to filter device positions (and get their velocity and acceleration at the same time)
+		class PosKalmanFilter
+		{
+		private:
+			AxisKalmanFilter<3> filter;
 		public:
-			void init(const vr::HmdVector3d_t& initPos = { 0, 0, 0 }, const vr::HmdVector3d_t& initVel = { 0, 0, 0 }, const double(&initCovariance)[2][2] = { { 100.0, 0.0 },{ 0.0, 100.0 } });
+			void init(const vr::HmdVector3d_t& initPos = { 0, 0, 0 }, const vr::HmdVector3d_t& initVel = { 0, 0, 0 }, const vr::HmdVector3d_t& initAcc = { 0, 0, 0 }, double initVariance = 100.0);
 			void setProcessNoise(double variance)
 			{
-				processNoise = variance;
+				filter.setProcessNoise(variance);
 			}
 			void setObservationNoise(double variance)
 			{
-				observationNoise = variance;
+				filter.setObservationNoise(variance);
 			}
 
 			void update(const vr::HmdVector3d_t& devicePos, double dt);
 
-			const vr::HmdVector3d_t& getUpdatedPositionEstimate()
+			vr::HmdVector3d_t getUpdatedPositionEstimate() const
+			{
+				return filter.state(0);
+			}
+			vr::HmdVector3d_t getUpdatedVelocityEstimate() const
+			{
+				return filter.state(1);
+			}
+			vr::HmdVector3d_t getUpdatedAccelerationEstimate() const
+			{
+				return filter.state(2);
+			}
+			double getLastInnovation() const
+			{
+				return filter.lastInnovation();
+			}
+		};
+
+
+		// Kalman filter to get angular velocity and acceleration from device orientations.
+		// The observed angular velocity is derived from the rotation between two consecutive orientations,
+		// it is expressed in the same space as the orientations (axis-angle, radians/second).
+		class RotKalmanFilter
+		{
+		private:
+			vr::HmdQuaternion_t lastRot = { 1.0, 0.0, 0.0, 0.0 };
+			AxisKalmanFilter<2> filter;
+		public:
+			void init(const vr::HmdQuaternion_t& initRot = { 1.0, 0.0, 0.0, 0.0 }, double initVariance = 100.0);
+			void setProcessNoise(double variance)
+			{
+				filter.setProcessNoise(variance);
+			}
+			void setObservationNoise(double variance)
+			{
+				filter.setObservationNoise(variance);
+			}
+
+			void update(const vr::HmdQuaternion_t& deviceRot, double dt);
+
+			vr::HmdVector3d_t getUpdatedAngularVelocityEstimate() const
 			{
-				return lastPos;
+				return filter.state(0);
 			}
-			const vr::HmdVector3d_t& getUpdatedVelocityEstimate()
+			vr::HmdVector3d_t getUpdatedAngularAccelerationEstimate() const
 			{
-				return lastVel;
+				return filter.state(1);
 			}
 		};
 	}
@@ -2,45 +2,38 @@
 
 #include <openvr_driver.h>
 #include <openvr_math.h>
-#include <mutex>
 
 // driver namespace
 namespace vrinputemulator
 {
 	namespace driver
 	{
+		// Moving average over the last bufferSize() values.
+		// The storage has a fixed capacity, so resizing on the pose thread never touches the heap.
 		class MovingAverageRingBuffer
 		{
 		public:
-			MovingAverageRingBuffer() noexcept : _buffer(new vr::HmdVector3d_t[1]), _bufferSize(1)
-			{
-			}
-			MovingAverageRingBuffer(unsigned size) noexcept : _buffer(new vr::HmdVector3d_t[size > 0 ? size : 1]), _bufferSize(size > 0 ? size : 1)
+			static const unsigned MaxSize = 64;
+
+			MovingAverageRingBuffer() noexcept : _bufferSize(1)
 			{
 			}
-			~MovingAverageRingBuffer() noexcept
+			MovingAverageRingBuffer(unsigned size) noexcept
 			{
-				std::lock_guard<std::mutex> lock(_mutex);
-				if (_buffer)
-				{
-					delete[] _buffer;
-					_buffer = nullptr;
-					_bufferSize = _dataStart = _dataSize = 0;
-				}
+				resize(size);
 			}
 
+			// size is clamped to 1 .. MaxSize
 			void resize(unsigned size) noexcept
 			{
-				std::lock_guard<std::mutex> lock(_mutex);
 				if (size == 0)
 				{
 					size = 1;
 				}
-				if (_buffer)
+				else if (size > MaxSize)
 				{
-					delete[] _buffer;
+					size = MaxSize;
 				}
-				_buffer = new vr::HmdVector3d_t[size];
 				_bufferSize = size;
 				_dataSize = _dataStart = 0;
 			}
@@ -87,8 +80,7 @@ namespace vrinputemulator
 			}
 
 		private:
-			std::mutex _mutex;
-			vr::HmdVector3d_t* _buffer;
+			vr::HmdVector3d_t _buffer[MaxSize];
 			unsigned _bufferSize;
 			unsigned _dataStart = 0;
 			unsigned _dataSize = 0;
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include "SeqLock.h"
+
+// driver namespace
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		// Fixed-size history of the last Capacity samples of a single producer, ordered by time.
+		//
+		// T needs a 'long long time' member. push() drops samples that are older than the newest stored one, so the history
+		// stays ordered even when the producer's timestamps jitter backwards.
+		// Only one thread may push, any number of threads may look up samples concurrently.
+		// Every slot sits on its own cache line and is guarded by its own sequence lock, so readers neither block the writer
+		// nor see half-written samples. Nothing is allocated after construction.
+		template<typename T, size_t Capacity>
+		class SampleHistory
+		{
+			static_assert(Capacity >= 2, "SampleHistory needs at least two slots");
+
+		public:
+			// Returns false when the sample has been dropped because it is out of order
+			bool push(const T& sample)
+			{
+				auto count = _count.load(std::memory_order_relaxed);
+				if (count > 0 && sample.time < _newestTime)
+				{
+					return false;
+				}
+				_newestTime = sample.time;
+				_slots[count % Capacity].sample.store(sample);
+				_count.store(count + 1, std::memory_order_release);
+				return true;
+			}
+
+			// Finds the two consecutive samples enclosing the given time.
+			// Returns 2 when before.time <= time < after.time.
+			// Returns 1 when time lies outside the stored range, before then holds the closest sample (newest or oldest).
+			// Returns 0 when the history is empty.
+			int lookup(long long time, T& before, T& after) const
+			{
+				auto count = _count.load(std::memory_order_acquire);
+				if (count == 0)
+				{
+					return 0;
+				}
+				T newer;
+				_slots[(count - 1) % Capacity].sample.load(newer);
+				if (newer.time <= time)
+				{
+					before = newer;
+					return 1;
+				}
+				auto oldest = count > Capacity ? count - Capacity : 0;
+				for (auto i = count - 1; i > oldest; i--)
+				{
+					T older;
+					_slots[(i - 1) % Capacity].sample.load(older);
+					if (older.time > newer.time)
+					{
+						break; // the writer has already wrapped around and overwritten this slot
+					}
+					if (older.time <= time)
+					{
+						before = older;
+						after = newer;
+						return 2;
+					}
+					newer = older;
+				}
+				before = newer;
+				return 1;
+			}
+
+			constexpr size_t capacity() const
+			{
+				return Capacity;
+			}
+
+		private:
+			struct alignas(64) _Slot
+			{
+				SeqLock<T> sample;
+			};
+
+			_Slot _slots[Capacity];
+			alignas(64) std::atomic<size_t> _count = { 0 };
+			long long _newestTime = 0; // only touched by the writer
+		};
+	}
+}
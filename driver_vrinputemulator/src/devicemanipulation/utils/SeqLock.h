@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <type_traits>
+
+// driver namespace
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		// Sequence lock for small, trivially copyable values that are read far more often than they are written.
+		//
+		// Readers never take a lock and never block a writer, they just retry when they raced with a store.
+		// Writers are serialized among themselves by the sequence counter itself, so any thread may call store().
+		template<typename T>
+		class SeqLock
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "SeqLock requires a trivially copyable type");
+
+		public:
+			SeqLock() : _value()
+			{
+			}
+			explicit SeqLock(const T& value) : _value(value)
+			{
+			}
+			SeqLock(const SeqLock&) = delete;
+			SeqLock& operator=(const SeqLock&) = delete;
+
+			void store(const T& value)
+			{
+				uint32_t seq = _seq.load(std::memory_order_relaxed);
+				while ((seq & 1) || !_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					seq = _seq.load(std::memory_order_relaxed);
+				}
+				std::atomic_thread_fence(std::memory_order_release);
+				_value = value;
+				_seq.store(seq + 2, std::memory_order_release);
+			}
+
+			void load(T& value) const
+			{
+				for (;;)
+				{
+					uint32_t seq1 = _seq.load(std::memory_order_acquire);
+					if (seq1 & 1)
+					{
+						continue; // store in progress
+					}
+					value = _value;
+					std::atomic_thread_fence(std::memory_order_acquire);
+					uint32_t seq2 = _seq.load(std::memory_order_relaxed);
+					if (seq1 == seq2)
+					{
+						return;
+					}
+				}
+			}
+
+			T load() const
+			{
+				T value;
+				load(value);
+				return value;
+			}
+
+			// Number of completed stores
+			uint32_t version() const
+			{
+				return _seq.load(std::memory_order_acquire) >> 1;
+			}
+
+		private:
+			std::atomic<uint32_t> _seq = { 0 };
+			T _value;
+		};
+	}
+}
@@ -0,0 +1,92 @@
+#include "AllocationTracker.h"
+
+#ifdef VRINPUTEMULATOR_ALLOCATION_TRACKING
+
+#include <cstdlib>
+#include <new>
+
+
+namespace
+{
+	// plain integer, thread_local variables of trivial types need no allocation themselves
+	thread_local uint64_t t_allocationCount = 0;
+
+	void* countedAlloc(std::size_t size)
+	{
+		t_allocationCount++;
+		void* p = std::malloc(size ? size : 1);
+		if (!p)
+		{
+			throw std::bad_alloc();
+		}
+		return p;
+	}
+}
+
+
+void* operator new(std::size_t size)
+{
+	return countedAlloc(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return countedAlloc(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	t_allocationCount++;
+	return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	t_allocationCount++;
+	return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		uint64_t AllocationTracker::_threadAllocationCount()
+		{
+			return t_allocationCount;
+		}
+
+	} // end namespace driver
+} // end namespace vrinputemulator
+
+#endif
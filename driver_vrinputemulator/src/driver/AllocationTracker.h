@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+
+// Define VRINPUTEMULATOR_ALLOCATION_TRACKING (e.g. in the project's preprocessor definitions) to replace the global
+// operator new of the driver dll with a counting one. The pose hook then reports every allocation it causes in the
+// statistics page (DeviceStats::poseHookAllocationCount) and logs an error for the first one of each device.
+// Without the define nothing is replaced and threadAllocationCount() is always 0.
+
+// driver namespace
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		class AllocationTracker
+		{
+		public:
+			static bool enabled()
+			{
+#ifdef VRINPUTEMULATOR_ALLOCATION_TRACKING
+				return true;
+#else
+				return false;
+#endif
+			}
+
+			// Number of heap allocations made by the calling thread so far
+			static uint64_t threadAllocationCount()
+			{
+#ifdef VRINPUTEMULATOR_ALLOCATION_TRACKING
+				return _threadAllocationCount();
+#else
+				return 0;
+#endif
+			}
+
+		private:
+			static uint64_t _threadAllocationCount();
+		};
+
+	} // end namespace driver
+} // end namespace vrinputemulator
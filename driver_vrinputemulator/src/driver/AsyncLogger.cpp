@@ -0,0 +1,176 @@
+#include "AsyncLogger.h"
+
+#include <sstream>
+#include "../logging.h"
+
+
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		std::atomic<uint32_t> AsyncLogger::_enabledLevels = { 0xffffffff };
+		std::atomic<bool> AsyncLogger::_writerStopFlag = { false };
+		std::atomic<bool> AsyncLogger::_writerSleeping = { false };
+		std::mutex AsyncLogger::_writerMutex;
+		std::condition_variable AsyncLogger::_writerWakeup;
+		std::atomic<uint64_t> AsyncLogger::_droppedRecords = { 0 };
+		std::thread AsyncLogger::_writerThread;
+		LockFreeRingBuffer<AsyncLogger::_Record, 4096> AsyncLogger::_buffer;
+
+
+		void AsyncLogger::start()
+		{
+			auto logger = el::Loggers::getLogger("default");
+			uint32_t levels = 0;
+			const el::Level elLevels[] = { el::Level::Trace, el::Level::Debug, el::Level::Info, el::Level::Warning, el::Level::Error };
+			for (unsigned i = 0; i < sizeof(elLevels) / sizeof(elLevels[0]); i++)
+			{
+				if (logger->enabled(elLevels[i]))
+				{
+					levels |= 1u << i;
+				}
+			}
+			_enabledLevels = levels;
+			if (!_writerThread.joinable())
+			{
+				_writerStopFlag = false;
+				_writerThread = std::thread(_writerThreadFunc);
+			}
+		}
+
+		void AsyncLogger::stop()
+		{
+			if (_writerThread.joinable())
+			{
+				{
+					std::lock_guard<std::mutex> lock(_writerMutex);
+					_writerStopFlag = true;
+				}
+				_writerWakeup.notify_one();
+				_writerThread.join();
+			}
+		}
+
+		void AsyncLogger::_format(const _Record& record, std::string& message)
+		{
+			std::ostringstream ss;
+			unsigned arg = 0;
+			for (const char* c = record.format; *c; c++)
+			{
+				if (c[0] == '{' && c[1] == '}' && arg < record.argCount)
+				{
+					auto value = record.args[arg];
+					switch (record.argTypes[arg])
+					{
+					case _ArgType::Int:
+						ss << (int64_t)value;
+						break;
+					case _ArgType::UInt:
+						ss << value;
+						break;
+					case _ArgType::Double:
+					{
+						double d;
+						std::memcpy(&d, &value, sizeof(d));
+						ss << d;
+					} break;
+					case _ArgType::Pointer:
+						ss << (const void*)(uintptr_t)value;
+						break;
+					case _ArgType::String:
+						ss << (record.text + value);
+						break;
+					}
+					arg++;
+					c++;
+				}
+				else
+				{
+					ss << *c;
+				}
+			}
+			message = ss.str();
+		}
+
+		void AsyncLogger::_write(const _Record& record, std::string& message)
+		{
+			_format(record, message);
+			switch (record.level)
+			{
+			case AsyncLogLevel::Trace:
+				LOG(TRACE) << message;
+				break;
+			case AsyncLogLevel::Debug:
+				LOG(DEBUG) << message;
+				break;
+			case AsyncLogLevel::Info:
+				LOG(INFO) << message;
+				break;
+			case AsyncLogLevel::Warning:
+				LOG(WARNING) << message;
+				break;
+			case AsyncLogLevel::Error:
+				LOG(ERROR) << message;
+				break;
+			}
+		}
+
+		void AsyncLogger::_wakeWriter()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_writerMutex);
+				_writerSleeping = false;
+			}
+			_writerWakeup.notify_one();
+		}
+
+		void AsyncLogger::_writerThreadFunc()
+		{
+			LOG(DEBUG) << "AsyncLogger::_writerThreadFunc: thread started";
+			_Record record;
+			std::string message;
+			bool stopping = false;
+			while (true)
+			{
+				bool written = false;
+				while (_buffer.tryPop(record))
+				{
+					_write(record, message);
+					written = true;
+				}
+				uint64_t drops = _droppedRecords.exchange(0);
+				if (drops > 0)
+				{
+					LOG(WARNING) << "Asynchronous logger fell behind, dropped " << drops << " log records";
+				}
+				if (stopping)
+				{
+					break;
+				}
+				if (_writerStopFlag)
+				{
+					// one last pass to catch records pushed while we were checking the flag
+					stopping = true;
+				}
+				else if (!written)
+				{
+					std::unique_lock<std::mutex> lock(_writerMutex);
+					_writerSleeping.store(true, std::memory_order_relaxed);
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					// a record pushed before the flag became visible won't wake us up, so look once more
+					if (_buffer.tryPop(record))
+					{
+						_writerSleeping = false;
+						lock.unlock();
+						_write(record, message);
+						continue;
+					}
+					_writerWakeup.wait(lock, [] { return !_writerSleeping || _writerStopFlag; });
+					_writerSleeping = false;
+				}
+			}
+			LOG(DEBUG) << "AsyncLogger::_writerThreadFunc: thread stopped";
+		}
+
+	} // end namespace driver
+} // end namespace vrinputemulator
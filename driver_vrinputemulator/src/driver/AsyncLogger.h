@@ -0,0 +1,225 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include "utils/LockFreeRingBuffer.h"
+
+
+// Log levels below VRINPUTEMULATOR_ASYNC_LOG_MIN_LEVEL are compiled out (0 .. trace, 1 .. debug, 2 .. info, 3 .. warning, 4 .. error).
+// Levels that are compiled in can still be disabled at runtime by the logging configuration.
+#ifndef VRINPUTEMULATOR_ASYNC_LOG_MIN_LEVEL
+	#ifdef NDEBUG
+		#define VRINPUTEMULATOR_ASYNC_LOG_MIN_LEVEL 1
+	#else
+		#define VRINPUTEMULATOR_ASYNC_LOG_MIN_LEVEL 0
+	#endif
+#endif
+
+#define ALOG_IMPL(level, ...) \
+	do { \
+		if (::vrinputemulator::driver::AsyncLogger::enabled(::vrinputemulator::driver::AsyncLogLevel::level)) \
+			::vrinputemulator::driver::AsyncLogger::log(::vrinputemulator::driver::AsyncLogLevel::level, __VA_ARGS__); \
+	} while (0)
+
+#if VRINPUTEMULATOR_ASYNC_LOG_MIN_LEVEL <= 0
+	#define ALOG_TRACE(...) ALOG_IMPL(Trace, __VA_ARGS__)
+#else
+	#define ALOG_TRACE(...) ((void)0)
+#endif
+#if VRINPUTEMULATOR_ASYNC_LOG_MIN_LEVEL <= 1
+	#define ALOG_DEBUG(...) ALOG_IMPL(Debug, __VA_ARGS__)
+#else
+	#define ALOG_DEBUG(...) ((void)0)
+#endif
+#if VRINPUTEMULATOR_ASYNC_LOG_MIN_LEVEL <= 2
+	#define ALOG_INFO(...) ALOG_IMPL(Info, __VA_ARGS__)
+#else
+	#define ALOG_INFO(...) ((void)0)
+#endif
+#if VRINPUTEMULATOR_ASYNC_LOG_MIN_LEVEL <= 3
+	#define ALOG_WARNING(...) ALOG_IMPL(Warning, __VA_ARGS__)
+#else
+	#define ALOG_WARNING(...) ((void)0)
+#endif
+#define ALOG_ERROR(...) ALOG_IMPL(Error, __VA_ARGS__)
+
+// Usage: ALOG(DEBUG, "Device {} sent {} poses", deviceId, count);
+#define ALOG(level, ...) ALOG_##level(__VA_ARGS__)
+
+
+// driver namespace
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		enum class AsyncLogLevel : uint8_t
+		{
+			Trace,
+			Debug,
+			Info,
+			Warning,
+			Error
+		};
+
+		/**
+		* Logger for hot paths (pose updates, event polling, ipc dispatch).
+		*
+		* Log sites only copy the format string pointer and the raw arguments into a fixed-size record and push it into a
+		* lock-free ring buffer. A background thread replaces the "{}" placeholders and hands the message to easylogging++,
+		* so it ends up in the same log file with the same configuration. When the writer falls behind, records are dropped
+		* instead of blocking the caller. Format strings must be string literals, string arguments are copied (and truncated
+		* when a record runs out of space). The writer thread sleeps while the buffer is empty, log sites only wake it up
+		* when it has announced that it is going to sleep.
+		**/
+		class AsyncLogger
+		{
+		public:
+			static const unsigned MaxArgs = 8;
+			static const unsigned TextCapacity = 96;
+
+			// Picks up the enabled levels from the logging configuration and starts the writer thread.
+			// Records logged before start() are kept and written once the thread runs.
+			static void start();
+			static void stop();
+
+			static bool enabled(AsyncLogLevel level)
+			{
+				return (_enabledLevels.load(std::memory_order_relaxed) & (1u << (unsigned)level)) != 0;
+			}
+
+			template<typename... Args>
+			static void log(AsyncLogLevel level, const char* format, const Args&... args)
+			{
+				static_assert(sizeof...(Args) <= MaxArgs, "Too many log arguments");
+				_Record record;
+				record.format = format;
+				record.level = level;
+				record.argCount = 0;
+				record.textSize = 0;
+				_packAll(record, args...);
+				if (!_buffer.tryPush(record))
+				{
+					_droppedRecords.fetch_add(1, std::memory_order_relaxed);
+				}
+				else
+				{
+					// pairs with the fence in _writerThreadFunc: either the writer sees our record or we see its flag
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					if (_writerSleeping.load(std::memory_order_relaxed))
+					{
+						_wakeWriter();
+					}
+				}
+			}
+
+		private:
+			enum class _ArgType : uint8_t
+			{
+				Int,
+				UInt,
+				Double,
+				Pointer,
+				String // value is the offset into text
+			};
+
+			struct _Record
+			{
+				const char* format;
+				AsyncLogLevel level;
+				uint8_t argCount;
+				uint8_t textSize;
+				_ArgType argTypes[MaxArgs];
+				uint64_t args[MaxArgs];
+				char text[TextCapacity];
+			};
+
+			static void _packAll(_Record&)
+			{
+			}
+			template<typename T, typename... Args>
+			static void _packAll(_Record& record, const T& arg, const Args&... args)
+			{
+				_pack(record, arg);
+				_packAll(record, args...);
+			}
+
+			static void _push(_Record& record, _ArgType type, uint64_t value)
+			{
+				record.argTypes[record.argCount] = type;
+				record.args[record.argCount++] = value;
+			}
+
+			template<typename T>
+			static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type _pack(_Record& record, T value)
+			{
+				_push(record, _ArgType::Int, (uint64_t)(int64_t)value);
+			}
+			template<typename T>
+			static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type _pack(_Record& record, T value)
+			{
+				_push(record, _ArgType::UInt, (uint64_t)value);
+			}
+			template<typename T>
+			static typename std::enable_if<std::is_enum<T>::value>::type _pack(_Record& record, T value)
+			{
+				_push(record, _ArgType::Int, (uint64_t)(int64_t)value);
+			}
+			template<typename T>
+			static typename std::enable_if<std::is_floating_point<T>::value>::type _pack(_Record& record, T value)
+			{
+				double d = value;
+				uint64_t bits;
+				std::memcpy(&bits, &d, sizeof(bits));
+				_push(record, _ArgType::Double, bits);
+			}
+			template<typename T>
+			static void _pack(_Record& record, T* value)
+			{
+				_push(record, _ArgType::Pointer, (uint64_t)(uintptr_t)value);
+			}
+			static void _pack(_Record& record, const char* value)
+			{
+				_packString(record, value, value ? std::strlen(value) : 0);
+			}
+			static void _pack(_Record& record, const std::string& value)
+			{
+				_packString(record, value.c_str(), value.size());
+			}
+			static void _packString(_Record& record, const char* value, size_t size)
+			{
+				size_t available = TextCapacity - record.textSize - 1;
+				if (size > available)
+				{
+					size = available;
+				}
+				if (size > 0)
+				{
+					std::memcpy(record.text + record.textSize, value, size);
+				}
+				record.text[record.textSize + size] = '\0';
+				_push(record, _ArgType::String, record.textSize);
+				record.textSize = (uint8_t)(record.textSize + size + 1 < TextCapacity ? record.textSize + size + 1 : TextCapacity - 1);
+			}
+
+			static void _format(const _Record& record, std::string& message);
+			static void _write(const _Record& record, std::string& message);
+			static void _wakeWriter();
+			static void _writerThreadFunc();
+
+			static std::atomic<uint32_t> _enabledLevels;
+			static std::atomic<bool> _writerStopFlag;
+			static std::atomic<bool> _writerSleeping;
+			static std::mutex _writerMutex;
+			static std::condition_variable _writerWakeup;
+			static std::atomic<uint64_t> _droppedRecords;
+			static std::thread _writerThread;
+			static LockFreeRingBuffer<_Record, 4096> _buffer;
+		};
+
+	} // end namespace driver
+} // end namespace vrinputemulator
@@ -0,0 +1,92 @@
+#include "PoseRecorder.h"
+
+#include <chrono>
+#include "../logging.h"
+
+
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		PoseRecorder::~PoseRecorder()
+		{
+			stop();
+		}
+
+		bool PoseRecorder::start(const std::string& filename)
+		{
+			if (_recording)
+			{
+				return true;
+			}
+			_file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!_file.is_open())
+			{
+				LOG(ERROR) << "Could not open pose recording file \"" << filename << "\"";
+				return false;
+			}
+			PoseRecordingHeader header;
+			memcpy(header.magic, PoseRecordingMagic, sizeof(PoseRecordingMagic));
+			header.version = POSE_RECORDING_VERSION;
+			header.recordSize = sizeof(PoseRecord);
+			_file.write((const char*)&header, sizeof(PoseRecordingHeader));
+			_filename = filename;
+			_droppedRecords = 0;
+			_writtenRecords = 0;
+			_writerStopFlag = false;
+			_writerThread = std::thread(_writerThreadFunc, this);
+			_recording = true;
+			LOG(INFO) << "Pose recording started: " << filename;
+			return true;
+		}
+
+		void PoseRecorder::stop()
+		{
+			if (_recording)
+			{
+				_recording = false;
+				_writerStopFlag = true;
+				_writerThread.join();
+				_file.close();
+				LOG(INFO) << "Pose recording stopped: " << _filename << " (" << _writtenRecords << " records written, " << _droppedRecords << " dropped)";
+			}
+		}
+
+		void PoseRecorder::_writerThreadFunc(PoseRecorder* _this)
+		{
+			LOG(DEBUG) << "PoseRecorder::_writerThreadFunc: thread started";
+			PoseRecord record;
+			bool stopping = false;
+			while (true)
+			{
+				bool written = false;
+				while (_this->_buffer.tryPop(record))
+				{
+					_this->_file.write((const char*)&record, sizeof(PoseRecord));
+					_this->_writtenRecords++;
+					written = true;
+				}
+				if (stopping)
+				{
+					break;
+				}
+				if (_this->_writerStopFlag)
+				{
+					// one last pass to catch records pushed while we were checking the flag
+					stopping = true;
+				}
+				else if (written)
+				{
+					_this->_file.flush();
+				}
+				else
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				}
+			}
+			_this->_file.flush();
+			LOG(DEBUG) << "PoseRecorder::_writerThreadFunc: thread stopped";
+		}
+
+	} // end namespace driver
+} // end namespace vrinputemulator
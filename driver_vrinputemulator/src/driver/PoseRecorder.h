@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <openvr_driver.h>
+#include <pose_recording.h>
+#include "utils/LockFreeRingBuffer.h"
+
+
+// driver namespace
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		/**
+		* Records every pose passing through the pose update hook into a binary file (see pose_recording.h).
+		*
+		* The hook only copies the record into a lock-free ring buffer, a background thread drains it to disk.
+		* When the writer falls behind, records are dropped instead of blocking the pose thread.
+		**/
+		class PoseRecorder
+		{
+		public:
+			~PoseRecorder();
+
+			bool start(const std::string& filename);
+			void stop();
+
+			bool isRecording() const
+			{
+				return _recording.load(std::memory_order_relaxed);
+			}
+
+			// Called from the pose update hook, never blocks
+			void record(uint32_t deviceId, int64_t timestamp, const vr::DriverPose_t& rawPose, const vr::DriverPose_t& compensatedPose, bool forwarded)
+			{
+				PoseRecord rec;
+				rec.deviceId = deviceId;
+				rec.forwarded = forwarded ? 1 : 0;
+				rec.timestamp = timestamp;
+				rec.rawPose = rawPose;
+				rec.compensatedPose = compensatedPose;
+				if (!_buffer.tryPush(rec))
+				{
+					_droppedRecords.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+
+		private:
+			static void _writerThreadFunc(PoseRecorder* _this);
+
+			std::atomic<bool> _recording = { false };
+			std::atomic<bool> _writerStopFlag = { false };
+			std::thread _writerThread;
+			std::ofstream _file;
+			std::string _filename;
+			std::atomic<uint64_t> _droppedRecords = { 0 };
+			uint64_t _writtenRecords = 0;
+			LockFreeRingBuffer<PoseRecord, 8192> _buffer;
+		};
+
+	} // end namespace driver
+} // end namespace vrinputemulator
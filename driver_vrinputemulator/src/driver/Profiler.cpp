@@ -0,0 +1,84 @@
+#include "Profiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include "../logging.h"
+
+
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		std::mutex Profiler::_registryMutex;
+		std::vector<std::unique_ptr<Profiler::_ThreadBuffer>> Profiler::_threadBuffers;
+
+
+		Profiler::_ThreadBuffer* Profiler::_registerThread()
+		{
+			std::lock_guard<std::mutex> lock(_registryMutex);
+			std::unique_ptr<_ThreadBuffer> buffer(new _ThreadBuffer());
+			buffer->threadId = (uint32_t)_threadBuffers.size() + 1;
+			_threadBuffers.push_back(std::move(buffer));
+			return _threadBuffers.back().get();
+		}
+
+		void Profiler::setThreadName(const char* name)
+		{
+			auto buffer = _threadBuffer();
+			std::lock_guard<std::mutex> lock(_registryMutex);
+			buffer->name = name;
+		}
+
+		bool Profiler::writeChromeTrace(const std::string& filename)
+		{
+			std::ofstream file(filename, std::ios::out | std::ios::trunc);
+			if (!file.is_open())
+			{
+				LOG(ERROR) << "Could not open trace file \"" << filename << "\"";
+				return false;
+			}
+			uint64_t eventCount = 0;
+			std::vector<_Event> events;
+			file << std::fixed << std::setprecision(3); // microseconds with nanosecond resolution
+			file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+			std::lock_guard<std::mutex> lock(_registryMutex);
+			for (auto& buffer : _threadBuffers)
+			{
+				// copy the events still in the ring, then drop those the owning thread overwrote while we copied
+				// (including the slot it may be writing right now)
+				auto head = buffer->head.load(std::memory_order_acquire);
+				auto first = head > EventsPerThread ? head - EventsPerThread : 0;
+				events.clear();
+				for (auto i = first; i < head; i++)
+				{
+					auto& slot = buffer->events[i & (EventsPerThread - 1)];
+					events.push_back({ slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed), slot.duration.load(std::memory_order_relaxed) });
+				}
+				std::atomic_thread_fence(std::memory_order_acquire);
+				auto headAfter = buffer->head.load(std::memory_order_relaxed);
+				auto firstValid = headAfter + 1 > EventsPerThread ? headAfter + 1 - EventsPerThread : 0;
+				auto skip = firstValid > first ? (size_t)(firstValid - first) : 0;
+
+				file << (eventCount++ ? ",\n" : "\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+					<< ",\"args\":{\"name\":\"" << (buffer->name ? buffer->name : "thread") << " " << buffer->threadId << "\"}}";
+				for (size_t i = skip; i < events.size(); i++)
+				{
+					auto& e = events[i];
+					file << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+						<< ",\"ts\":" << (double)e.start / 1000.0 << ",\"dur\":" << (double)e.duration / 1000.0 << "}";
+					eventCount++;
+				}
+			}
+			file << "\n]}\n";
+			file.close();
+			if (file.fail())
+			{
+				LOG(ERROR) << "Could not write trace file \"" << filename << "\"";
+				return false;
+			}
+			LOG(INFO) << "Wrote " << eventCount << " trace events to " << filename;
+			return true;
+		}
+
+	} // end namespace driver
+} // end namespace vrinputemulator
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <monotonic_clock.h>
+
+
+// Profiling zones are compiled in only when VRINPUTEMULATOR_PROFILING is defined (e.g. in the project's preprocessor definitions).
+// Zone and thread names must be string literals, they are stored as pointers and written to the trace unescaped.
+#ifdef VRINPUTEMULATOR_PROFILING
+	#define PROFILE_CONCAT_IMPL(a, b) a##b
+	#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+	#define PROFILE_ZONE(name) ::vrinputemulator::driver::ProfileZone PROFILE_CONCAT(_profileZone, __LINE__)(name)
+	#define PROFILE_THREAD_NAME(name) ::vrinputemulator::driver::Profiler::setThreadName(name)
+#else
+	#define PROFILE_ZONE(name) ((void)0)
+	#define PROFILE_THREAD_NAME(name) ((void)0)
+#endif
+
+
+// driver namespace
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		/**
+		* Collects timed zones of all driver threads and writes them as Chrome trace JSON (chrome://tracing, Perfetto).
+		*
+		* Every thread writes into its own ring buffer that keeps the most recent events, so recording never locks and
+		* never allocates after the first zone of a thread. Dumping copies the buffers while they are being written and
+		* drops the events that were overwritten in the meantime.
+		**/
+		class Profiler
+		{
+		public:
+			static const size_t EventsPerThread = 16384;
+
+			static bool enabled()
+			{
+#ifdef VRINPUTEMULATOR_PROFILING
+				return true;
+#else
+				return false;
+#endif
+			}
+
+			// Called by ProfileZone, start and end are MonotonicClock timestamps
+			static void record(const char* name, int64_t start, int64_t end)
+			{
+				auto buffer = _threadBuffer();
+				auto head = buffer->head.load(std::memory_order_relaxed);
+				auto& slot = buffer->events[head & (EventsPerThread - 1)];
+				slot.name.store(name, std::memory_order_relaxed);
+				slot.start.store(start, std::memory_order_relaxed);
+				slot.duration.store(end - start, std::memory_order_relaxed);
+				buffer->head.store(head + 1, std::memory_order_release);
+				// Seqlock writer side: the slot stores of the next event must not become visible before this head.
+				// Pairs with the acquire fence in writeChromeTrace, a reader that sees overwritten slot data also sees the new head.
+				std::atomic_thread_fence(std::memory_order_release);
+			}
+
+			// Name shown for the calling thread in the trace
+			static void setThreadName(const char* name);
+
+			static bool writeChromeTrace(const std::string& filename);
+
+		private:
+			struct _Event
+			{
+				const char* name;
+				int64_t start;
+				int64_t duration;
+			};
+
+			// slots are read while their thread may overwrite them, hence the (relaxed) atomics
+			struct _EventSlot
+			{
+				std::atomic<const char*> name = { nullptr };
+				std::atomic<int64_t> start = { 0 };
+				std::atomic<int64_t> duration = { 0 };
+			};
+
+			struct _ThreadBuffer
+			{
+				uint32_t threadId;
+				const char* name = nullptr; // guarded by _registryMutex
+				std::atomic<uint64_t> head = { 0 };
+				_EventSlot events[EventsPerThread];
+			};
+
+			static_assert((EventsPerThread & (EventsPerThread - 1)) == 0, "EventsPerThread must be a power of two");
+
+			static _ThreadBuffer* _threadBuffer()
+			{
+				static thread_local _ThreadBuffer* buffer = nullptr;
+				if (!buffer)
+				{
+					buffer = _registerThread();
+				}
+				return buffer;
+			}
+			static _ThreadBuffer* _registerThread();
+
+			// buffers outlive their threads, so events of finished threads still show up in the trace
+			static std::mutex _registryMutex;
+			static std::vector<std::unique_ptr<_ThreadBuffer>> _threadBuffers;
+		};
+
+
+		// Times the enclosing scope, see PROFILE_ZONE
+		class ProfileZone
+		{
+		public:
+			explicit ProfileZone(const char* name) : _name(name), _start(MonotonicClock::now())
+			{
+			}
+			~ProfileZone()
+			{
+				Profiler::record(_name, _start, MonotonicClock::now());
+			}
+			ProfileZone(const ProfileZone&) = delete;
+			ProfileZone& operator=(const ProfileZone&) = delete;
+
+		private:
+			const char* _name;
+			int64_t _start;
+		};
+
+	} // end namespace driver
+} // end namespace vrinputemulator
@@ -25,20 +25,10 @@ namespace vrinputemulator
 		}
 
 
-		bool ServerDriver::hooksTrackedDevicePoseUpdated(void* serverDriverHost, int version, uint32_t& unWhichDevice, vr::DriverPose_t& newPose, uint32_t& unPoseStructSize)
-		{
-			if (_openvrIdToDeviceManipulationHandleMap[unWhichDevice] && _openvrIdToDeviceManipulationHandleMap[unWhichDevice]->isValid())
-			{
-				return _openvrIdToDeviceManipulationHandleMap[unWhichDevice]->handlePoseUpdate(unWhichDevice, newPose, unPoseStructSize);
-			}
-			return true;
-		}
-
 		bool ServerDriver::hooksPollNextEvent(void* serverDriverHost, int version, void* pEvent, uint32_t uncbVREvent)
 		{
 			vr::VREvent_t* event = (vr::VREvent_t*)pEvent;
-			LOG(DEBUG) << "ServerDriver::hooksPollNextEvent(" << serverDriverHost << ", " << version << ", " << pEvent << ", " << uncbVREvent << ")"
-				<< " : " << event->eventType << ", " << event->trackedDeviceIndex;
+			ALOG(DEBUG, "ServerDriver::hooksPollNextEvent({}, {}, {}, {}) : {}, {}", serverDriverHost, version, pEvent, uncbVREvent, event->eventType, event->trackedDeviceIndex);
 			return true;
 		}
 
@@ -81,6 +71,22 @@ namespace vrinputemulator
 				_propertyContainerToDeviceManipulationHandleMap[container] = handle.get();
 
 				LOG(INFO) << "Successfully added device " << handle->serialNumber() << " (OpenVR Id: " << handle->openvrId() << ")";
+
+				auto stats = deviceStats(unObjectId);
+				if (stats)
+				{
+					stats->deviceClass.store(handle->deviceClass(), std::memory_order_relaxed);
+					stats->deviceMode.store(handle->deviceMode(), std::memory_order_relaxed);
+					stats->active.store(1, std::memory_order_relaxed);
+				}
+
+				DriverEvent event = {};
+				event.type = DriverEventType::DeviceAdded;
+				event.deviceId = unObjectId;
+				event.deviceClass = handle->deviceClass();
+				event.deviceMode = handle->deviceMode();
+				event.motionCompensationStatus = m_motionCompensation.motionCompensationStatus();
+				publishDriverEvent(event);
 			}
 		}
 
@@ -183,8 +189,20 @@ namespace vrinputemulator
 
 		vr::EVRInitError ServerDriver::Init(vr::IVRDriverContext* pDriverContext)
 		{
+			AsyncLogger::start();
 			LOG(TRACE) << "CServerDriver::Init()";
 
+			// Create statistics page (before any hook can update it)
+			try
+			{
+				m_stats = ipc::ShmMapping<ipc::ShmStatsBlock>::create(m_statsName);
+			}
+			catch (std::exception & e)
+			{
+				m_stats.reset();
+				LOG(WARNING) << "Could not create statistics page: " << e.what();
+			}
+
 			// Initialize Hooking
 			InterfaceHooks::setServerDriver(this);
 			auto mhError = MH_Initialize();
@@ -239,6 +257,30 @@ namespace vrinputemulator
 				_propertiesOverrideGenericTrackerFakeController = boolVal;
 				LOG(INFO) << vrsettings_SectionName << "::" << vrsettings_genericTrackerFakeController_bool << " = " << boolVal;
 			}
+			boolVal = vr::VRSettings()->GetBool(vrsettings_SectionName, vrsettings_poseRecordingEnabled_bool, &peError);
+			if (peError == vr::VRSettingsError_None && boolVal)
+			{
+				std::string poseRecordingFile = "driver_vrinputemulator_poses.bin";
+				vr::VRSettings()->GetString(vrsettings_SectionName, vrsettings_poseRecordingFile_string, buffer, vr::k_unMaxPropertyStringSize, &peError);
+				if (peError == vr::VRSettingsError_None && buffer[0] != '\0')
+				{
+					poseRecordingFile = buffer;
+				}
+				LOG(INFO) << vrsettings_SectionName << "::" << vrsettings_poseRecordingFile_string << " = " << poseRecordingFile;
+				m_poseRecorder.start(poseRecordingFile);
+			}
+			boolVal = vr::VRSettings()->GetBool(vrsettings_SectionName, vrsettings_motionCompensationRefPrediction_bool, &peError);
+			if (peError == vr::VRSettingsError_None)
+			{
+				double maxPrediction = m_motionCompensation.motionCompensationConfig().refPosePredictionMax;
+				auto floatVal = vr::VRSettings()->GetFloat(vrsettings_SectionName, vrsettings_motionCompensationRefPredictionMaxMs_float, &peError);
+				if (peError == vr::VRSettingsError_None && floatVal > 0.0f)
+				{
+					maxPrediction = floatVal / 1000.0;
+				}
+				m_motionCompensation.setMotionCompensationRefPosePrediction(boolVal, maxPrediction);
+				LOG(INFO) << vrsettings_SectionName << "::" << vrsettings_motionCompensationRefPrediction_bool << " = " << boolVal << " (max " << maxPrediction * 1000.0 << " ms)";
+			}
 
 			// Start IPC thread
 			shmCommunicator.init(this);
@@ -252,6 +294,9 @@ namespace vrinputemulator
 			_driverContextHooks.reset();
 			MH_Uninitialize();
 			shmCommunicator.shutdown();
+			m_poseRecorder.stop();
+			m_stats.reset();
+			AsyncLogger::stop();
 			VR_CLEANUP_SERVER_DRIVER_CONTEXT();
 		}
 
@@ -259,11 +304,13 @@ namespace vrinputemulator
 		// Call frequency: ~93Hz
 		void ServerDriver::RunFrame()
 		{
+			PROFILE_ZONE("ServerDriver::RunFrame");
 			for (auto d : _deviceManipulationHandles)
 			{
 				d.second->RunFrame();
 			}
 			m_motionCompensation.runFrame();
+			shmCommunicator.runFrame();
 		}
 
 		void ServerDriver::_trackedDeviceActivated(uint32_t deviceId, VirtualDeviceDriver* device)
@@ -279,11 +326,11 @@ namespace vrinputemulator
 		void ServerDriver::openvr_poseUpdate(uint32_t unWhichDevice, vr::DriverPose_t& newPose, int64_t timestamp)
 		{
 			auto devicePtr = this->m_openvrIdToVirtualDeviceMap[unWhichDevice];
-			auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			auto now = MonotonicClock::now();
 			auto diff = 0.0;
 			if (timestamp < now)
 			{
-				diff = ((double)now - timestamp) / 1000.0;
+				diff = MonotonicClock::toSeconds(now - timestamp);
 			}
 			if (devicePtr)
 			{
@@ -299,7 +346,7 @@ namespace vrinputemulator
 			}
 		}
 
-		void ServerDriver::openvr_vendorSpecificEvent(uint32_t unWhichDevice, vr::EVREventType eventType, vr::VREvent_Data_t& eventData, double eventTimeOffset)
+		void ServerDriver::openvr_vendorSpecificEvent(uint32_t unWhichDevice, vr::EVREventType eventType, const vr::VREvent_Data_t& eventData, double eventTimeOffset)
 		{
 			vr::VRServerDriverHost()->VendorSpecificEvent(unWhichDevice, eventType, eventData, eventTimeOffset);
 		}
@@ -327,9 +374,14 @@ namespace vrinputemulator
 		}
 
 
-		void ServerDriver::sendReplySetMotionCompensationMode(bool success)
+		void ServerDriver::sendReplySetMotionCompensationMode(uint32_t deviceId, bool success)
+		{
+			shmCommunicator.sendReplySetMotionCompensationMode(deviceId, success);
+		}
+
+		void ServerDriver::publishDriverEvent(const DriverEvent& event)
 		{
-			shmCommunicator.sendReplySetMotionCompensationMode(success);
+			shmCommunicator.publishEvent(event);
 		}
 
 
@@ -6,10 +6,16 @@
 #include <openvr_driver.h>
 #include <vrinputemulator_types.h>
 #include <openvr_math.h>
+#include <monotonic_clock.h>
+#include <ipc_stats.h>
 #include "../hooks/common.h"
 #include "../logging.h"
 #include "../com/shm/driver_ipc_shm.h"
 #include "../devicemanipulation/MotionCompensationManager.h"
+#include "PoseRecorder.h"
+#include "Profiler.h"
+#include "AsyncLogger.h"
+#include "AllocationTracker.h"
 
 
 
@@ -83,7 +89,7 @@ namespace vrinputemulator
 				return installDir;
 			}
 
-			void openvr_vendorSpecificEvent(uint32_t unWhichDevice, vr::EVREventType eventType, vr::VREvent_Data_t& eventData, double eventTimeOffset);
+			void openvr_vendorSpecificEvent(uint32_t unWhichDevice, vr::EVREventType eventType, const vr::VREvent_Data_t& eventData, double eventTimeOffset);
 
 			void openvr_poseUpdate(uint32_t unWhichDevice, vr::DriverPose_t& newPose, int64_t timestamp);
 
@@ -111,7 +117,26 @@ namespace vrinputemulator
 			{
 				return m_motionCompensation;
 			}
-			void sendReplySetMotionCompensationMode(bool success);
+			void sendReplySetMotionCompensationMode(uint32_t deviceId, bool success);
+			/** May block, must not be called from pose threads */
+			void publishDriverEvent(const DriverEvent& event);
+
+			/* Live statistics */
+			/** Returns the statistics of the given device, or nullptr when the statistics page is not available */
+			ipc::ShmStatsDevice* deviceStats(uint32_t openvrId)
+			{
+				return m_stats && openvrId < vr::k_unMaxTrackedDeviceCount ? &(*m_stats)->devices[openvrId] : nullptr;
+			}
+			/** Returns the pose hook latency histograms of the given device, or nullptr when the statistics page is not available */
+			ipc::ShmPoseHookHistograms* poseHookHistograms(uint32_t openvrId)
+			{
+				return m_stats && openvrId < vr::k_unMaxTrackedDeviceCount ? &(*m_stats)->poseHook[openvrId] : nullptr;
+			}
+			/** Returns the statistics page, or nullptr when it is not available */
+			ipc::ShmStatsBlock* stats()
+			{
+				return m_stats ? m_stats->operator->() : nullptr;
+			}
 
 			//// function hooks related ////
 			void hooksTrackedDeviceAdded(void* serverDriverHost, int version, const char* pchDeviceSerialNumber, vr::ETrackedDeviceClass& eDeviceClass, void* pDriver);
@@ -152,6 +177,13 @@ namespace vrinputemulator
 			//// motion compensation related ////
 			MotionCompensationManager m_motionCompensation;
 
+			//// pose recording related ////
+			PoseRecorder m_poseRecorder;
+
+			//// statistics related ////
+			std::unique_ptr<ipc::ShmMapping<ipc::ShmStatsBlock>> m_stats;
+			std::string m_statsName = "driver_vrinputemulator.stats";
+
 			//// function hooks related ////
 			std::shared_ptr<InterfaceHooks> _driverContextHooks;
 
@@ -0,0 +1,51 @@
+#include "ServerDriver.h"
+
+#include "../devicemanipulation/DeviceManipulationHandle.h"
+
+
+// The pose hook has its own translation unit, so the Linux tests can link it against the stub ServerDriver (see bench/support)
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		bool ServerDriver::hooksTrackedDevicePoseUpdated(void* serverDriverHost, int version, uint32_t& unWhichDevice, vr::DriverPose_t& newPose, uint32_t& unPoseStructSize)
+		{
+			auto stats = deviceStats(unWhichDevice);
+			auto histograms = poseHookHistograms(unWhichDevice);
+			auto start = stats ? MonotonicClock::now() : 0;
+			auto allocations = AllocationTracker::threadAllocationCount();
+			bool retval = true;
+			if (m_poseRecorder.isRecording())
+			{
+				auto rawPose = newPose;
+				if (_openvrIdToDeviceManipulationHandleMap[unWhichDevice] && _openvrIdToDeviceManipulationHandleMap[unWhichDevice]->isValid())
+				{
+					retval = _openvrIdToDeviceManipulationHandleMap[unWhichDevice]->handlePoseUpdate(unWhichDevice, newPose, unPoseStructSize);
+				}
+				m_poseRecorder.record(unWhichDevice, MonotonicClock::now(), rawPose, newPose, retval);
+			}
+			else if (_openvrIdToDeviceManipulationHandleMap[unWhichDevice] && _openvrIdToDeviceManipulationHandleMap[unWhichDevice]->isValid())
+			{
+				retval = _openvrIdToDeviceManipulationHandleMap[unWhichDevice]->handlePoseUpdate(unWhichDevice, newPose, unPoseStructSize);
+			}
+			if (stats)
+			{
+				auto elapsed = (uint64_t)(MonotonicClock::now() - start);
+				stats->add(stats->poseUpdateCount, 1);
+				stats->add(stats->hookTimeNs, elapsed);
+				histograms->processing.record(elapsed);
+				if (AllocationTracker::enabled())
+				{
+					// the pose path must not touch the heap, see AllocationTracker.h
+					allocations = AllocationTracker::threadAllocationCount() - allocations;
+					if (allocations > 0 && stats->poseHookAllocationCount.fetch_add(allocations, std::memory_order_relaxed) == 0)
+					{
+						ALOG(ERROR, "Pose hook of device {} allocated memory {} times", unWhichDevice, allocations);
+					}
+				}
+			}
+			return retval;
+		}
+
+	} // end namespace driver
+} // end namespace vrinputemulator
@@ -1,6 +1,7 @@
 #include "VirtualDeviceDriver.h"
 
 #include "../logging.h"
+#include "AsyncLogger.h"
 
 
 namespace vrinputemulator
@@ -67,14 +68,14 @@ namespace vrinputemulator
 
 		vr::DriverPose_t VirtualDeviceDriver::GetPose()
 		{
-			LOG(TRACE) << "VirtualDeviceDriver[" << m_serialNumber << "]::GetPose()";
+			ALOG(TRACE, "VirtualDeviceDriver[{}]::GetPose()", m_serialNumber);
 			return m_pose;
 		}
 
 
 		void VirtualDeviceDriver::updatePose(const vr::DriverPose_t& newPose, double timeOffset, bool notify)
 		{
-			LOG(TRACE) << "VirtualDeviceDriver[" << m_serialNumber << "]::updatePose( " << timeOffset << " )";
+			ALOG(TRACE, "VirtualDeviceDriver[{}]::updatePose( {} )", m_serialNumber, timeOffset);
 			std::lock_guard<std::recursive_mutex> lock(_mutex);
 			m_pose = newPose;
 			m_pose.poseTimeOffset += timeOffset;
@@ -86,7 +87,7 @@ namespace vrinputemulator
 
 		void VirtualDeviceDriver::sendPoseUpdate(double timeOffset, bool onlyWhenConnected)
 		{
-			LOG(TRACE) << "VirtualDeviceDriver[" << m_serialNumber << "]::sendPoseUpdate( " << timeOffset << " )";
+			ALOG(TRACE, "VirtualDeviceDriver[{}]::sendPoseUpdate( {} )", m_serialNumber, timeOffset);
 			std::lock_guard<std::recursive_mutex> lock(_mutex);
 			if (!onlyWhenConnected || (m_pose.poseIsValid && m_pose.deviceIsConnected))
 			{
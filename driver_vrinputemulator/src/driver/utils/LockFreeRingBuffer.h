@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// driver namespace
+namespace vrinputemulator
+{
+	namespace driver
+	{
+		// Bounded multi-producer/multi-consumer queue (Dmitry Vyukov's design).
+		// Producers never block: when the buffer is full tryPush() simply fails and the caller decides what to do.
+		// The storage is allocated once in the constructor, so pushing and popping never touches the heap.
+		template<typename T, size_t Capacity>
+		class LockFreeRingBuffer
+		{
+			static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+		public:
+			LockFreeRingBuffer() : _buffer(new _Cell[Capacity])
+			{
+				for (size_t i = 0; i < Capacity; i++)
+				{
+					_buffer[i].sequence.store(i, std::memory_order_relaxed);
+				}
+			}
+			~LockFreeRingBuffer()
+			{
+				delete[] _buffer;
+			}
+			LockFreeRingBuffer(const LockFreeRingBuffer&) = delete;
+			LockFreeRingBuffer& operator=(const LockFreeRingBuffer&) = delete;
+
+			bool tryPush(const T& value)
+			{
+				_Cell* cell;
+				size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+				for (;;)
+				{
+					cell = &_buffer[pos & (Capacity - 1)];
+					size_t seq = cell->sequence.load(std::memory_order_acquire);
+					intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+					if (diff == 0)
+					{
+						if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						{
+							break;
+						}
+					}
+					else if (diff < 0)
+					{
+						return false; // full
+					}
+					else
+					{
+						pos = _enqueuePos.load(std::memory_order_relaxed);
+					}
+				}
+				cell->data = value;
+				cell->sequence.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+
+			bool tryPop(T& value)
+			{
+				_Cell* cell;
+				size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+				for (;;)
+				{
+					cell = &_buffer[pos & (Capacity - 1)];
+					size_t seq = cell->sequence.load(std::memory_order_acquire);
+					intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+					if (diff == 0)
+					{
+						if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						{
+							break;
+						}
+					}
+					else if (diff < 0)
+					{
+						return false; // empty
+					}
+					else
+					{
+						pos = _dequeuePos.load(std::memory_order_relaxed);
+					}
+				}
+				value = cell->data;
+				cell->sequence.store(pos + Capacity, std::memory_order_release);
+				return true;
+			}
+
+			constexpr size_t capacity() const
+			{
+				return Capacity;
+			}
+
+		private:
+			struct _Cell
+			{
+				std::atomic<size_t> sequence;
+				T data;
+			};
+
+			_Cell* const _buffer;
+			alignas(64) std::atomic<size_t> _enqueuePos = { 0 };
+			alignas(64) std::atomic<size_t> _dequeuePos = { 0 };
+		};
+	}
+}
@@ -66,7 +66,14 @@ namespace vrinputemulator
 			auto poseCopy = newPose;
 			if (serverDriver->hooksTrackedDevicePoseUpdated(_this, 4, unWhichDevice, poseCopy, unPoseStructSize))
 			{
+				// our own processing is timed by hooksTrackedDevicePoseUpdated(), here we time SteamVR
+				auto histograms = serverDriver->poseHookHistograms(unWhichDevice);
+				auto start = histograms ? MonotonicClock::now() : 0;
 				trackedDevicePoseUpdatedHook.origFunc(_this, unWhichDevice, poseCopy, unPoseStructSize);
+				if (histograms)
+				{
+					histograms->steamvr.record((uint64_t)(MonotonicClock::now() - start));
+				}
 			}
 		}
 
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <stdint.h>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include "ipc_protocol.h"
+
+
+namespace vrinputemulator
+{
+	namespace ipc
+	{
+		// Wire format of the message queues.
+		//
+		// A frame is a FrameHeader followed by FrameHeader::count records. A record is a uint32_t length followed by the first
+		// length bytes of a Request or Reply, that is the common fields plus only the active member of the message union.
+		// Records start on 8 byte boundaries. A frame with more than one record is a batch, its records are handled in order.
+		// The shared memory rings use the same record sizes, see ShmSpscRing.
+
+		static const uint32_t FrameMagic = 0x46454956; // "VIEF"
+		static const uint32_t MaxFrameSize = 4096;
+
+		struct FrameHeader
+		{
+			uint32_t magic;
+			uint32_t count;
+		};
+
+		static_assert(std::is_trivially_copyable<Request>::value && std::is_trivially_copyable<Reply>::value, "Messages are copied bytewise");
+		static_assert(sizeof(FrameHeader) + sizeof(uint64_t) + sizeof(Reply) <= MaxFrameSize, "Every message must fit into a frame");
+
+
+		// Number of bytes of the message union used by the given message
+		inline uint32_t payloadSize(const Request& message)
+		{
+			switch (message.type)
+			{
+			case RequestType::None:
+				return 0;
+			case RequestType::IPC_ClientConnect:
+				return sizeof(Request_IPC_ClientConnect);
+			case RequestType::IPC_ClientDisconnect:
+				return sizeof(Request_IPC_ClientDisconnect);
+			case RequestType::IPC_Ping:
+				return sizeof(Request_IPC_Ping);
+			case RequestType::IPC_Subscribe:
+				return sizeof(Request_IPC_Subscribe);
+			case RequestType::OpenVR_VendorSpecificEvent:
+				return sizeof(Request_OpenVR_VendorSpecificEvent);
+			case RequestType::DeviceManipulation_GetAllDeviceInfos:
+			case RequestType::Stats_ResetHistograms:
+				return sizeof(Request_OpenVR_GenericClientMessage);
+			case RequestType::DeviceManipulation_GetDeviceInfo:
+			case RequestType::DeviceManipulation_DefaultMode:
+				return sizeof(Request_OpenVR_GenericDeviceIdMessage);
+			case RequestType::DeviceManipulation_MotionCompensationMode:
+				return sizeof(Request_DeviceManipulation_MotionCompensationMode);
+			case RequestType::DeviceManipulation_SetMotionCompensationProperties:
+				return sizeof(Request_DeviceManipulation_SetMotionCompensationProperties);
+			case RequestType::DeviceManipulation_ApplyMotionCompensation:
+				return sizeof(Request_DeviceManipulation_ApplyMotionCompensation);
+			case RequestType::Profiler_WriteTrace:
+				return sizeof(Request_Profiler_WriteTrace);
+			default:
+				return sizeof(Request::MsgUnion);
+			}
+		}
+
+		inline uint32_t payloadSize(const Reply& message)
+		{
+			switch (message.type)
+			{
+			case ReplyType::None:
+			case ReplyType::GenericReply:
+				return 0;
+			case ReplyType::IPC_ClientConnect:
+				return sizeof(Reply_IPC_ClientConnect);
+			case ReplyType::IPC_Ping:
+				return sizeof(Reply_IPC_Ping);
+			case ReplyType::IPC_Event:
+				return sizeof(DriverEvent);
+			case ReplyType::DeviceManipulation_GetDeviceInfo:
+				return sizeof(Reply_DeviceManipulation_GetDeviceInfo);
+			case ReplyType::DeviceManipulation_GetAllDeviceInfos:
+			{
+				// only the devices that are actually there
+				uint32_t count = message.msg.dm_allDeviceInfos.deviceCount;
+				if (count > vr::k_unMaxTrackedDeviceCount)
+				{
+					count = vr::k_unMaxTrackedDeviceCount;
+				}
+				return (uint32_t)(offsetof(Reply_DeviceManipulation_GetAllDeviceInfos, devices) + count * sizeof(Reply_DeviceManipulation_GetDeviceInfo));
+			}
+			default:
+				return sizeof(Reply::MsgUnion);
+			}
+		}
+
+		// Number of bytes of the given message that need to be transferred
+		template<typename Message>
+		inline uint32_t messageSize(const Message& message)
+		{
+			return (uint32_t)offsetof(Message, msg) + payloadSize(message);
+		}
+
+
+		// Collects one or more messages into a frame
+		template<typename Message>
+		class FrameWriter
+		{
+		public:
+			FrameWriter()
+			{
+				clear();
+			}
+
+			void clear()
+			{
+				FrameHeader header = { FrameMagic, 0 };
+				std::memcpy(_buffer, &header, sizeof(header));
+				_size = sizeof(header);
+				_count = 0;
+			}
+
+			// Returns false when the message does not fit into this frame anymore
+			bool append(const Message& message)
+			{
+				uint32_t length = messageSize(message);
+				uint32_t recordSize = _align(sizeof(uint32_t) + length);
+				if (_size + recordSize > MaxFrameSize)
+				{
+					return false;
+				}
+				std::memcpy(_buffer + _size, &length, sizeof(length));
+				std::memcpy(_buffer + _size + sizeof(length), &message, length);
+				_size += recordSize;
+				_count++;
+				std::memcpy(_buffer + offsetof(FrameHeader, count), &_count, sizeof(_count));
+				return true;
+			}
+
+			uint32_t count() const
+			{
+				return _count;
+			}
+			bool empty() const
+			{
+				return _count == 0;
+			}
+			const void* data() const
+			{
+				return _buffer;
+			}
+			uint32_t size() const
+			{
+				return _size;
+			}
+
+		private:
+			static uint32_t _align(uint32_t size)
+			{
+				return (size + 7) & ~7u;
+			}
+
+			alignas(8) uint8_t _buffer[MaxFrameSize];
+			uint32_t _size;
+			uint32_t _count;
+		};
+
+
+		// Iterates over the messages of a received frame. Malformed frames and records are rejected, never read out of bounds.
+		template<typename Message>
+		class FrameReader
+		{
+		public:
+			FrameReader(const void* data, size_t size) : _data((const uint8_t*)data), _size(size)
+			{
+				FrameHeader header;
+				if (size >= sizeof(header))
+				{
+					std::memcpy(&header, data, sizeof(header));
+					if (header.magic == FrameMagic)
+					{
+						_valid = true;
+						_remaining = header.count;
+						_offset = sizeof(header);
+					}
+				}
+			}
+
+			bool valid() const
+			{
+				return _valid;
+			}
+
+			// Returns false when there are no more messages or the next record is malformed
+			bool next(Message& message)
+			{
+				uint32_t length;
+				if (!_valid || _remaining == 0 || _offset + sizeof(length) > _size)
+				{
+					return false;
+				}
+				std::memcpy(&length, _data + _offset, sizeof(length));
+				if (length < offsetof(Message, msg) || length > sizeof(Message) || _offset + sizeof(length) + length > _size)
+				{
+					_valid = false;
+					return false;
+				}
+				std::memset(&message.msg, 0, sizeof(message.msg));
+				std::memcpy(&message, _data + _offset + sizeof(length), length);
+				_offset += (sizeof(length) + length + 7) & ~(size_t)7;
+				_remaining--;
+				return true;
+			}
+
+		private:
+			const uint8_t* _data;
+			size_t _size;
+			size_t _offset = 0;
+			uint32_t _remaining = 0;
+			bool _valid = false;
+		};
+
+
+		// Clients from before the framing (ipc protocol versions 3 to 7) send the whole Request struct of their version unframed and only
+		// accept unframed replies of exactly their sizeof(Reply). Their IPC_ClientConnect starts like the current one, so the driver can
+		// still tell them that their version is not supported.
+		struct LegacyProtocol
+		{
+			uint32_t version;
+			uint32_t requestSize;
+			uint32_t replySize;
+		};
+
+		static const LegacyProtocol LegacyProtocols[] = {
+			{ 3, 152, 40 },
+			{ 4, 152, 40 },
+			{ 5, 280, 40 },
+			{ 6, 280, 1056 },
+			{ 7, 280, 1056 },
+		};
+
+		static_assert(offsetof(Request, msg) == 16 && offsetof(Request_IPC_ClientConnect, queueName) == 8, "IPC_ClientConnect must start like the legacy one");
+		static_assert(offsetof(Reply, msg) == 24 && offsetof(Reply_IPC_ClientConnect, ipcProcotolVersion) == 4, "Connect replies must start like the legacy ones");
+		static_assert(sizeof(Reply) >= 1056, "Legacy replies are sent from a Reply");
+
+		// Returns the size of the reply a legacy client expects when the received data is its IPC_ClientConnect, otherwise 0.
+		// The request is copied into message, fields the legacy version does not have are zeroed.
+		inline uint32_t readLegacyClientConnect(const void* data, size_t size, Request& message)
+		{
+			if (size < offsetof(Request, msg) + sizeof(uint32_t) * 2 || size > sizeof(Request))
+			{
+				return 0;
+			}
+			std::memset(&message.msg, 0, sizeof(message.msg));
+			std::memcpy(&message, data, size);
+			if (message.type != RequestType::IPC_ClientConnect)
+			{
+				return 0;
+			}
+			for (auto& legacy : LegacyProtocols)
+			{
+				if (legacy.version == message.msg.ipc_ClientConnect.ipcProcotolVersion && legacy.requestSize == size)
+				{
+					message.msg.ipc_ClientConnect.queueName[sizeof(message.msg.ipc_ClientConnect.queueName) - 1] = '\0';
+					message.msg.ipc_ClientConnect.shmChannelName[0] = '\0';
+					return legacy.replySize;
+				}
+			}
+			return 0;
+		}
+
+	} // end namespace ipc
+} // end namespace vrinputemulator
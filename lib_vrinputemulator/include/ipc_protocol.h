@@ -1,10 +1,11 @@
 #pragma once
 
 #include "vrinputemulator_types.h"
+#include "monotonic_clock.h"
 #include <utility>
 
 
-#define IPC_PROTOCOL_VERSION 3
+#define IPC_PROTOCOL_VERSION 15
 
 namespace vrinputemulator
 {
@@ -23,7 +24,14 @@ namespace vrinputemulator
 			OpenVR_VendorSpecificEvent,
 			DeviceManipulation_DefaultMode,
 			DeviceManipulation_MotionCompensationMode,
-			DeviceManipulation_SetMotionCompensationProperties
+			DeviceManipulation_SetMotionCompensationProperties,
+			DeviceManipulation_GetAllDeviceInfos,
+
+			IPC_Subscribe,
+			DeviceManipulation_ApplyMotionCompensation,
+
+			Stats_ResetHistograms,
+			Profiler_WriteTrace
 
 		};
 
@@ -36,7 +44,10 @@ namespace vrinputemulator
 
 			GenericReply,
 
-			DeviceManipulation_GetDeviceInfo
+			DeviceManipulation_GetDeviceInfo,
+			DeviceManipulation_GetAllDeviceInfos,
+
+			IPC_Event // pushed by the driver, messageId is always 0
 
 		};
 
@@ -53,7 +64,8 @@ namespace vrinputemulator
 			InvalidVersion,
 			MissingProperty,
 			InvalidOperation,
-			NotTracking
+			NotTracking,
+			InvalidParameter
 		};
 
 		struct Request_IPC_ClientConnect
@@ -61,6 +73,7 @@ namespace vrinputemulator
 			uint32_t messageId;
 			uint32_t ipcProcotolVersion;
 			char queueName[128];
+			char shmChannelName[128]; // empty when the client only wants to use the message queues
 		};
 
 		struct Request_IPC_ClientDisconnect
@@ -69,6 +82,13 @@ namespace vrinputemulator
 			uint32_t messageId;
 		};
 
+		struct Request_IPC_Subscribe
+		{
+			uint32_t clientId;
+			uint32_t messageId;
+			uint32_t eventMask; // DriverEventType bits, 0 unsubscribes
+		};
+
 		struct Request_IPC_Ping
 		{
 			uint32_t clientId;
@@ -115,10 +135,34 @@ namespace vrinputemulator
 			double kalmanFilterProcessNoise;
 			bool kalmanFilterObservationNoiseValid;
 			double kalmanFilterObservationNoise;
+			bool rotKalmanFilterNoiseValid;
+			double rotKalmanFilterProcessNoise;
+			double rotKalmanFilterObservationNoise;
 			bool movingAverageWindowValid;
 			unsigned movingAverageWindow;
 		};
 
+		// Complete motion compensation configuration plus the reference device, applied in one step
+		struct Request_DeviceManipulation_ApplyMotionCompensation
+		{
+			uint32_t clientId;
+			uint32_t messageId; // Used to associate with Reply
+			uint32_t deviceId;
+			MotionCompensationVelAccMode velAccCompensationMode;
+			double kalmanFilterProcessNoise;
+			double kalmanFilterObservationNoise;
+			double rotKalmanFilterProcessNoise; // angular velocity filter, (rad/s^2)^2
+			double rotKalmanFilterObservationNoise; // angular velocity filter, (rad/s)^2
+			unsigned movingAverageWindow;
+		};
+
+		struct Request_Profiler_WriteTrace
+		{
+			uint32_t clientId;
+			uint32_t messageId; // Used to associate with Reply
+			char filename[256]; // bare file name, the driver writes it to its log directory
+		};
+
 		struct Request
 		{
 			Request()
@@ -126,7 +170,7 @@ namespace vrinputemulator
 			}
 			Request(RequestType type) : type(type)
 			{
-				timestamp = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+				timestamp = MonotonicClock::now();
 			}
 			Request(RequestType type, uint64_t timestamp) : type(type), timestamp(timestamp)
 			{
@@ -134,21 +178,24 @@ namespace vrinputemulator
 
 			void refreshTimestamp()
 			{
-				timestamp = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+				timestamp = MonotonicClock::now();
 			}
 
 			RequestType type = RequestType::None;
-			int64_t timestamp = 0; // milliseconds since epoch
+			int64_t timestamp = 0; // nanoseconds, see MonotonicClock
 			union MsgUnion
 			{
 				Request_IPC_ClientConnect ipc_ClientConnect;
 				Request_IPC_ClientDisconnect ipc_ClientDisconnect;
 				Request_IPC_Ping ipc_Ping;
+				Request_IPC_Subscribe ipc_Subscribe;
 				Request_OpenVR_VendorSpecificEvent ovr_VendorSpecificEvent;
 				Request_OpenVR_GenericClientMessage ovr_GenericClientMessage;
 				Request_OpenVR_GenericDeviceIdMessage ovr_GenericDeviceIdMessage;
 				Request_DeviceManipulation_MotionCompensationMode dm_MotionCompensationMode;
 				Request_DeviceManipulation_SetMotionCompensationProperties dm_SetMotionCompensationProperties;
+				Request_DeviceManipulation_ApplyMotionCompensation dm_ApplyMotionCompensation;
+				Request_Profiler_WriteTrace prof_WriteTrace;
 				MsgUnion()
 				{
 				}
@@ -159,6 +206,7 @@ namespace vrinputemulator
 		{
 			uint32_t clientId;
 			uint32_t ipcProcotolVersion;
+			bool shmChannelAccepted; // all further replies are sent over the shared memory channel
 		};
 
 		struct Reply_IPC_Ping
@@ -174,6 +222,13 @@ namespace vrinputemulator
 			uint32_t refDeviceId;
 		};
 
+		struct Reply_DeviceManipulation_GetAllDeviceInfos
+		{
+			MotionCompensationStatus motionCompensationStatus;
+			uint32_t deviceCount;
+			Reply_DeviceManipulation_GetDeviceInfo devices[vr::k_unMaxTrackedDeviceCount];
+		};
+
 		struct Reply
 		{
 			Reply()
@@ -181,21 +236,23 @@ namespace vrinputemulator
 			}
 			Reply(ReplyType type) : type(type)
 			{
-				timestamp = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+				timestamp = MonotonicClock::now();
 			}
 			Reply(ReplyType type, uint64_t timestamp) : type(type), timestamp(timestamp)
 			{
 			}
 
 			ReplyType type = ReplyType::None;
-			uint64_t timestamp = 0; // milliseconds since epoch
+			uint64_t timestamp = 0; // nanoseconds, see MonotonicClock
 			uint32_t messageId;
 			ReplyStatus status;
 			union MsgUnion
 			{
 				Reply_IPC_ClientConnect ipc_ClientConnect;
 				Reply_IPC_Ping ipc_Ping;
+				DriverEvent ipc_Event;
 				Reply_DeviceManipulation_GetDeviceInfo dm_deviceInfo;
+				Reply_DeviceManipulation_GetAllDeviceInfos dm_allDeviceInfos;
 				MsgUnion()
 				{
 				}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/sync/interprocess_semaphore.hpp>
+#include "ipc_protocol.h"
+#include "ipc_framing.h"
+
+
+namespace vrinputemulator
+{
+	namespace ipc
+	{
+		// Shared memory transport between client and driver.
+		//
+		// Every client owns one ShmChannelBlock with a request ring (client -> driver) and a reply ring (driver -> client).
+		// The driver owns a ShmDoorbellBlock that clients signal after pushing a request, so one driver thread can wait for all clients.
+		// Waiting is done on interprocess semaphores (futex based on Linux), pushing and popping never enters the kernel
+		// unless somebody is actually waiting.
+		// The boost message queues remain the fallback when a shared memory channel cannot be set up.
+
+		// Lock-free atomics are address-free and can therefore be shared between processes
+		static_assert(ATOMIC_INT_LOCK_FREE == 2, "Shared memory rings need lock-free 32 bit atomics");
+
+		// Single-producer/single-consumer ring buffer that lives in shared memory.
+		// Only the first size bytes of a value are copied in and out, see messageSize().
+		template<typename T, uint32_t Capacity>
+		class ShmSpscRing
+		{
+			static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+			static_assert(std::is_trivially_copyable<T>::value, "Values are copied bytewise");
+
+		public:
+			bool tryPush(const T& value, uint32_t size = sizeof(T))
+			{
+				auto head = _head.load(std::memory_order_relaxed);
+				if (head - _tail.load(std::memory_order_acquire) >= Capacity)
+				{
+					return false; // full
+				}
+				auto index = head & (Capacity - 1);
+				std::memcpy(&_slots[index], &value, size);
+				_sizes[index] = size;
+				_head.store(head + 1, std::memory_order_release);
+				return true;
+			}
+
+			bool tryPop(T& value)
+			{
+				auto tail = _tail.load(std::memory_order_relaxed);
+				if (tail == _head.load(std::memory_order_acquire))
+				{
+					return false; // empty
+				}
+				auto index = tail & (Capacity - 1);
+				auto size = _sizes[index];
+				std::memcpy(&value, &_slots[index], size <= sizeof(T) ? size : sizeof(T));
+				_tail.store(tail + 1, std::memory_order_release);
+				return true;
+			}
+
+		private:
+			alignas(64) std::atomic<uint32_t> _head = { 0 }; // written by the producer only
+			alignas(64) std::atomic<uint32_t> _tail = { 0 }; // written by the consumer only
+			alignas(64) uint32_t _sizes[Capacity];
+			alignas(64) T _slots[Capacity];
+		};
+
+		struct ShmChannelBlock
+		{
+			uint32_t ipcProtocolVersion = IPC_PROTOCOL_VERSION;
+			std::atomic<uint32_t> closed = { 0 }; // set by the client before it unmaps the channel
+			std::atomic<uint32_t> evicted = { 0 }; // set by the driver before it stops serving the channel, see repliesAvailable
+			boost::interprocess::interprocess_semaphore repliesAvailable{ 0 };
+			ShmSpscRing<Request, 64> requests;
+			ShmSpscRing<Reply, 64> replies;
+		};
+
+		struct ShmDoorbellBlock
+		{
+			uint32_t ipcProtocolVersion = IPC_PROTOCOL_VERSION;
+			boost::interprocess::interprocess_semaphore requestsAvailable{ 0 };
+		};
+
+
+		// Maps a shared memory block into the process.
+		// The creating side constructs the block and removes the shared memory object again on destruction.
+		template<typename Block>
+		class ShmMapping
+		{
+		public:
+			static std::unique_ptr<ShmMapping> create(const std::string& name)
+			{
+				std::unique_ptr<ShmMapping> mapping(new ShmMapping(name, true));
+				boost::interprocess::shared_memory_object::remove(name.c_str());
+				boost::interprocess::shared_memory_object shm(boost::interprocess::create_only, name.c_str(), boost::interprocess::read_write);
+				shm.truncate(sizeof(Block));
+				mapping->_region = boost::interprocess::mapped_region(shm, boost::interprocess::read_write);
+				mapping->_block = new (mapping->_region.get_address()) Block();
+				return mapping;
+			}
+
+			// A read-only mapping must not be written to, only loads from its atomics are allowed
+			static std::unique_ptr<ShmMapping> open(const std::string& name, bool readOnly = false)
+			{
+				std::unique_ptr<ShmMapping> mapping(new ShmMapping(name, false));
+				auto mode = readOnly ? boost::interprocess::read_only : boost::interprocess::read_write;
+				boost::interprocess::shared_memory_object shm(boost::interprocess::open_only, name.c_str(), mode);
+				mapping->_region = boost::interprocess::mapped_region(shm, mode);
+				if (mapping->_region.get_size() < sizeof(Block))
+				{
+					throw std::runtime_error("Shared memory block \"" + name + "\" is too small");
+				}
+				mapping->_block = (Block*)mapping->_region.get_address();
+				if (mapping->_block->ipcProtocolVersion != IPC_PROTOCOL_VERSION)
+				{
+					throw std::runtime_error("Shared memory block \"" + name + "\" has an incompatible ipc protocol version");
+				}
+				return mapping;
+			}
+
+			~ShmMapping()
+			{
+				if (_owner && _block)
+				{
+					_block->~Block();
+					_region = boost::interprocess::mapped_region();
+					boost::interprocess::shared_memory_object::remove(_name.c_str());
+				}
+			}
+
+			ShmMapping(const ShmMapping&) = delete;
+			ShmMapping& operator=(const ShmMapping&) = delete;
+
+			Block* operator->() const
+			{
+				return _block;
+			}
+
+			const std::string& name() const
+			{
+				return _name;
+			}
+
+		private:
+			ShmMapping(const std::string& name, bool owner) : _name(name), _owner(owner)
+			{
+			}
+
+			std::string _name;
+			bool _owner;
+			boost::interprocess::mapped_region _region;
+			Block* _block = nullptr;
+		};
+
+	} // end namespace ipc
+} // end namespace vrinputemulator
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <cstring>
+#include "ipc_protocol.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+namespace vrinputemulator
+{
+	// Statistics of one device, see VRInputEmulator::getDriverStats()
+	struct DeviceStats
+	{
+		uint32_t deviceId = vr::k_unTrackedDeviceIndexInvalid;
+		vr::ETrackedDeviceClass deviceClass = vr::TrackedDeviceClass_Invalid;
+		int deviceMode = 0;
+		uint64_t poseUpdateCount = 0; // pose updates seen by the pose hook
+		uint64_t hookTimeNs = 0; // total time spent in the pose hook
+		uint64_t velAccFallbackCount = 0; // poses that reused the last velocities because they came too close to the previous one
+		double kalmanInnovation = 0.0; // length of the last position innovation of the Kalman filter (meters)
+		uint64_t poseHookAllocationCount = 0; // heap allocations made by the pose hook, only counted by drivers built with VRINPUTEMULATOR_ALLOCATION_TRACKING
+	};
+
+	// Statistics of the whole driver. Copied without allocating, so it can be sampled at a high rate.
+	struct DriverStats
+	{
+		MotionCompensationStatus motionCompensationStatus = MotionCompensationStatus::WaitingForZeroRef;
+		uint32_t deviceCount = 0;
+		DeviceStats devices[vr::k_unMaxTrackedDeviceCount];
+	};
+
+
+	// Log-linear latency histogram (HDR style) in nanoseconds.
+	// Values below SubBucketCount get a bucket each, above that every power of two is split into SubBucketCount buckets,
+	// so a bucket is never wider than 1/SubBucketCount (12.5%) of its values. Values from about 0.5 s upwards share the last bucket.
+	struct LatencyHistogram
+	{
+		static const uint32_t SubBucketBits = 3;
+		static const uint32_t SubBucketCount = 1 << SubBucketBits;
+		static const uint32_t MaxExponent = 29;
+		static const uint32_t BucketCount = (MaxExponent - SubBucketBits + 2) << SubBucketBits;
+
+		uint64_t counts[BucketCount] = {};
+
+		static uint32_t bucketIndex(uint64_t value)
+		{
+			if (value < SubBucketCount)
+			{
+				return (uint32_t)value;
+			}
+#ifdef _MSC_VER
+			unsigned long exponent;
+			_BitScanReverse64(&exponent, value);
+#else
+			uint32_t exponent = 63 - __builtin_clzll(value);
+#endif
+			if (exponent > MaxExponent)
+			{
+				return BucketCount - 1;
+			}
+			uint32_t shift = exponent - SubBucketBits;
+			return ((shift + 1) << SubBucketBits) + (uint32_t)((value >> shift) & (SubBucketCount - 1));
+		}
+
+		// smallest value that falls into the given bucket
+		static uint64_t bucketLowerBound(uint32_t index)
+		{
+			if (index < SubBucketCount)
+			{
+				return index;
+			}
+			uint32_t shift = (index >> SubBucketBits) - 1;
+			return (uint64_t)(SubBucketCount + (index & (SubBucketCount - 1))) << shift;
+		}
+
+		void merge(const LatencyHistogram& other)
+		{
+			for (uint32_t i = 0; i < BucketCount; i++)
+			{
+				counts[i] += other.counts[i];
+			}
+		}
+
+		uint64_t totalCount() const
+		{
+			uint64_t total = 0;
+			for (uint32_t i = 0; i < BucketCount; i++)
+			{
+				total += counts[i];
+			}
+			return total;
+		}
+
+		// Lower bound of the bucket containing the given percentile (0.0 - 100.0), 0 for an empty histogram
+		uint64_t percentile(double p) const
+		{
+			uint64_t total = totalCount();
+			uint64_t rank = (uint64_t)(p / 100.0 * (double)total + 0.5);
+			uint64_t seen = 0;
+			for (uint32_t i = 0; i < BucketCount; i++)
+			{
+				seen += counts[i];
+				if (seen > 0 && seen >= rank)
+				{
+					return bucketLowerBound(i);
+				}
+			}
+			return 0;
+		}
+	};
+
+
+	namespace ipc
+	{
+		// Live statistics page published by the driver in shared memory.
+		//
+		// The driver updates the counters with relaxed atomics from whatever thread observes the event, clients map the page
+		// read-only and copy it whenever they like. Each value is consistent on its own, there is no consistency across values.
+
+		static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The statistics page needs lock-free 64 bit atomics");
+
+		struct alignas(64) ShmStatsDevice // one cache line per device, devices are updated from different threads
+		{
+			std::atomic<uint32_t> active = { 0 };
+			std::atomic<uint32_t> deviceClass = { 0 };
+			std::atomic<int32_t> deviceMode = { 0 };
+			std::atomic<uint64_t> poseUpdateCount = { 0 };
+			std::atomic<uint64_t> hookTimeNs = { 0 };
+			std::atomic<uint64_t> velAccFallbackCount = { 0 };
+			std::atomic<uint64_t> kalmanInnovationBits = { 0 }; // bit pattern of a double
+			std::atomic<uint64_t> poseHookAllocationCount = { 0 };
+
+			void add(std::atomic<uint64_t>& counter, uint64_t value)
+			{
+				counter.fetch_add(value, std::memory_order_relaxed);
+			}
+
+			void setKalmanInnovation(double value)
+			{
+				uint64_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+				kalmanInnovationBits.store(bits, std::memory_order_relaxed);
+			}
+
+			double kalmanInnovation() const
+			{
+				double value;
+				uint64_t bits = kalmanInnovationBits.load(std::memory_order_relaxed);
+				std::memcpy(&value, &bits, sizeof(value));
+				return value;
+			}
+		};
+
+		// Shared memory version of LatencyHistogram
+		struct ShmLatencyHistogram
+		{
+			std::atomic<uint64_t> counts[LatencyHistogram::BucketCount];
+
+			ShmLatencyHistogram()
+			{
+				reset();
+			}
+
+			void record(uint64_t value)
+			{
+				counts[LatencyHistogram::bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+			}
+
+			// Concurrent records may survive a reset, good enough for monitoring
+			void reset()
+			{
+				for (auto& c : counts)
+				{
+					c.store(0, std::memory_order_relaxed);
+				}
+			}
+
+			void addTo(LatencyHistogram& histogram) const
+			{
+				for (uint32_t i = 0; i < LatencyHistogram::BucketCount; i++)
+				{
+					histogram.counts[i] += counts[i].load(std::memory_order_relaxed);
+				}
+			}
+		};
+
+		// Time spent in the TrackedDevicePoseUpdated hook of one device, split into our own processing and the call into SteamVR
+		struct alignas(64) ShmPoseHookHistograms
+		{
+			ShmLatencyHistogram processing;
+			ShmLatencyHistogram steamvr;
+		};
+
+		struct ShmStatsBlock
+		{
+			uint32_t ipcProtocolVersion = IPC_PROTOCOL_VERSION;
+			std::atomic<uint32_t> motionCompensationStatus = { 0 };
+			ShmStatsDevice devices[vr::k_unMaxTrackedDeviceCount];
+			ShmPoseHookHistograms poseHook[vr::k_unMaxTrackedDeviceCount]; // per device, so pose threads never share a histogram
+
+			void copyTo(DriverStats& stats) const
+			{
+				stats.motionCompensationStatus = (MotionCompensationStatus)motionCompensationStatus.load(std::memory_order_relaxed);
+				stats.deviceCount = 0;
+				for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; ++id)
+				{
+					auto& src = devices[id];
+					if (src.active.load(std::memory_order_relaxed))
+					{
+						auto& dst = stats.devices[stats.deviceCount++];
+						dst.deviceId = id;
+						dst.deviceClass = (vr::ETrackedDeviceClass)src.deviceClass.load(std::memory_order_relaxed);
+						dst.deviceMode = src.deviceMode.load(std::memory_order_relaxed);
+						dst.poseUpdateCount = src.poseUpdateCount.load(std::memory_order_relaxed);
+						dst.hookTimeNs = src.hookTimeNs.load(std::memory_order_relaxed);
+						dst.velAccFallbackCount = src.velAccFallbackCount.load(std::memory_order_relaxed);
+						dst.kalmanInnovation = src.kalmanInnovation();
+						dst.poseHookAllocationCount = src.poseHookAllocationCount.load(std::memory_order_relaxed);
+					}
+				}
+			}
+		};
+
+	} // end namespace ipc
+} // end namespace vrinputemulator
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+
+namespace vrinputemulator
+{
+	// Central time source for pose timing and IPC timestamps.
+	//
+	// Based on std::chrono::steady_clock, which never jumps or slews with NTP adjustments. On Windows it is backed by
+	// QueryPerformanceCounter, an invariant-TSC derived counter that Windows calibrates itself and that is consistent across processes,
+	// so timestamps taken by the client can be compared with timestamps taken by the driver.
+	// All values are in nanoseconds with an unspecified epoch; only differences are meaningful.
+	struct MonotonicClock
+	{
+		static int64_t now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		static double toSeconds(int64_t nanoseconds)
+		{
+			return (double)nanoseconds / 1.0E9;
+		}
+
+		static int64_t fromSeconds(double seconds)
+		{
+			return (int64_t)(seconds * 1.0E9);
+		}
+	};
+
+} // end namespace vrinputemulator
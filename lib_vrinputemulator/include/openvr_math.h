@@ -1,6 +1,23 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
+
+// SIMD kernels are picked at compile time from the target architecture flags (/arch:AVX, /arch:AVX2, -mavx, ...).
+// Define VRMATH_NO_SIMD to force the scalar implementations.
+#if !defined(VRMATH_NO_SIMD)
+	#if defined(__AVX__)
+		#define VRMATH_AVX
+	#endif
+	#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#define VRMATH_SSE2
+	#endif
+#endif
+#if defined(VRMATH_AVX)
+	#include <immintrin.h>
+#elif defined(VRMATH_SSE2)
+	#include <emmintrin.h>
+#endif
 
 
 inline vr::HmdQuaternion_t operator+(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs)
@@ -25,12 +42,51 @@ inline vr::HmdQuaternion_t operator-(const vr::HmdQuaternion_t& lhs, const vr::H
 
 inline vr::HmdQuaternion_t operator*(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs)
 {
+#if defined(VRMATH_AVX)
+	// r = lhs.w * (w, x, y, z) + lhs.x * (-x, w, -z, y) + lhs.y * (-y, z, w, -x) + lhs.z * (-z, -y, x, w)
+	__m256d r = _mm256_loadu_pd(&rhs.w);
+	__m256d rSwapped = _mm256_permute_pd(r, 0x5); // (x, w, z, y)
+	__m256d rHalves = _mm256_permute2f128_pd(r, r, 0x1); // (y, z, w, x)
+	__m256d rHalvesSwapped = _mm256_permute_pd(rHalves, 0x5); // (z, y, x, w)
+	__m256d res = _mm256_mul_pd(_mm256_set1_pd(lhs.w), r);
+	res = _mm256_add_pd(res, _mm256_mul_pd(_mm256_set1_pd(lhs.x), _mm256_xor_pd(rSwapped, _mm256_set_pd(0.0, -0.0, 0.0, -0.0))));
+	res = _mm256_add_pd(res, _mm256_mul_pd(_mm256_set1_pd(lhs.y), _mm256_xor_pd(rHalves, _mm256_set_pd(-0.0, 0.0, 0.0, -0.0))));
+	res = _mm256_add_pd(res, _mm256_mul_pd(_mm256_set1_pd(lhs.z), _mm256_xor_pd(rHalvesSwapped, _mm256_set_pd(0.0, 0.0, -0.0, -0.0))));
+	vr::HmdQuaternion_t result;
+	_mm256_storeu_pd(&result.w, res);
+	return result;
+#elif defined(VRMATH_SSE2)
+	// same as above, split into the (w, x) and (y, z) halves
+	__m128d rLo = _mm_loadu_pd(&rhs.w);
+	__m128d rHi = _mm_loadu_pd(&rhs.y);
+	__m128d rLoSwapped = _mm_shuffle_pd(rLo, rLo, 0x1); // (x, w)
+	__m128d rHiSwapped = _mm_shuffle_pd(rHi, rHi, 0x1); // (z, y)
+	__m128d negLo = _mm_set_pd(0.0, -0.0);
+	__m128d negHi = _mm_set_pd(-0.0, 0.0);
+	__m128d lw = _mm_set1_pd(lhs.w);
+	__m128d lx = _mm_set1_pd(lhs.x);
+	__m128d ly = _mm_set1_pd(lhs.y);
+	__m128d lz = _mm_set1_pd(lhs.z);
+	__m128d resLo = _mm_mul_pd(lw, rLo);
+	resLo = _mm_add_pd(resLo, _mm_mul_pd(lx, _mm_xor_pd(rLoSwapped, negLo)));
+	resLo = _mm_add_pd(resLo, _mm_mul_pd(ly, _mm_xor_pd(rHi, negLo)));
+	resLo = _mm_sub_pd(resLo, _mm_mul_pd(lz, rHiSwapped));
+	__m128d resHi = _mm_mul_pd(lw, rHi);
+	resHi = _mm_add_pd(resHi, _mm_mul_pd(lx, _mm_xor_pd(rHiSwapped, negLo)));
+	resHi = _mm_add_pd(resHi, _mm_mul_pd(ly, _mm_xor_pd(rLo, negHi)));
+	resHi = _mm_add_pd(resHi, _mm_mul_pd(lz, rLoSwapped));
+	vr::HmdQuaternion_t result;
+	_mm_storeu_pd(&result.w, resLo);
+	_mm_storeu_pd(&result.y, resHi);
+	return result;
+#else
 	return {
 		(lhs.w * rhs.w) - (lhs.x * rhs.x) - (lhs.y * rhs.y) - (lhs.z * rhs.z),
 		(lhs.w * rhs.x) + (lhs.x * rhs.w) + (lhs.y * rhs.z) - (lhs.z * rhs.y),
 		(lhs.w * rhs.y) + (lhs.y * rhs.w) + (lhs.z * rhs.x) - (lhs.x * rhs.z),
 		(lhs.w * rhs.z) + (lhs.z * rhs.w) + (lhs.x * rhs.y) - (lhs.y * rhs.x)
 	};
+#endif
 }
 
 inline vr::HmdVector3d_t operator+(const vr::HmdVector3d_t& lhs, const vr::HmdVector3d_t& rhs)
@@ -90,6 +146,12 @@ inline vr::HmdVector3d_t operator/(const vr::HmdVector3d_t& lhs, const double rh
 namespace vrmath
 {
 
+	// Row-major 3x3 matrix in double precision (openvr only offers float matrices)
+	struct Matrix33d
+	{
+		double m[3][3];
+	};
+
 	template<typename T> int signum(T v)
 	{
 		return (v > (T)0) ? 1 : ((v < (T)0) ? -1 : 0);
@@ -200,19 +262,31 @@ namespace vrmath
 		};
 	}
 
+	// Vector part of lhs * (0, x, y, z) * rhs.
+	// Plain scalar code on purpose: going through the SIMD quaternion product would assemble (0, x, y, z) in memory and read the
+	// intermediate product back element by element, both of which stall store forwarding (see bench/vrmath_bench.cpp).
+	inline vr::HmdVector3d_t quaternionSandwich(const vr::HmdQuaternion_t& lhs, double x, double y, double z, const vr::HmdQuaternion_t& rhs)
+	{
+		double tw = -(lhs.x * x) - (lhs.y * y) - (lhs.z * z);
+		double tx = (lhs.w * x) + (lhs.y * z) - (lhs.z * y);
+		double ty = (lhs.w * y) + (lhs.z * x) - (lhs.x * z);
+		double tz = (lhs.w * z) + (lhs.x * y) - (lhs.y * x);
+		return {
+			(tw * rhs.x) + (tx * rhs.w) + (ty * rhs.z) - (tz * rhs.y),
+			(tw * rhs.y) + (ty * rhs.w) + (tz * rhs.x) - (tx * rhs.z),
+			(tw * rhs.z) + (tz * rhs.w) + (tx * rhs.y) - (ty * rhs.x)
+		};
+	}
+
 	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdVector3d_t& vector, bool reverse = false)
 	{
 		if (reverse)
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = vrmath::quaternionConjugate(quat) * pin * quat;
-			return { pout.x, pout.y, pout.z };
+			return quaternionSandwich(vrmath::quaternionConjugate(quat), vector.v[0], vector.v[1], vector.v[2], quat);
 		}
 		else
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = quat * pin * vrmath::quaternionConjugate(quat);
-			return { pout.x, pout.y, pout.z };
+			return quaternionSandwich(quat, vector.v[0], vector.v[1], vector.v[2], vrmath::quaternionConjugate(quat));
 		}
 	}
 
@@ -220,15 +294,11 @@ namespace vrmath
 	{
 		if (reverse)
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = quatInv * pin * quat;
-			return{ pout.x, pout.y, pout.z };
+			return quaternionSandwich(quatInv, vector.v[0], vector.v[1], vector.v[2], quat);
 		}
 		else
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = quat * pin * quatInv;
-			return{ pout.x, pout.y, pout.z };
+			return quaternionSandwich(quat, vector.v[0], vector.v[1], vector.v[2], quatInv);
 		}
 	}
 
@@ -236,15 +306,11 @@ namespace vrmath
 	{
 		if (reverse)
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = vrmath::quaternionConjugate(quat) * pin * quat;
-			return{ pout.x, pout.y, pout.z };
+			return quaternionSandwich(vrmath::quaternionConjugate(quat), vector[0], vector[1], vector[2], quat);
 		}
 		else
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = quat * pin * vrmath::quaternionConjugate(quat);
-			return{ pout.x, pout.y, pout.z };
+			return quaternionSandwich(quat, vector[0], vector[1], vector[2], vrmath::quaternionConjugate(quat));
 		}
 	}
 
@@ -252,16 +318,167 @@ namespace vrmath
 	{
 		if (reverse)
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = quatInv * pin * quat;
-			return{ pout.x, pout.y, pout.z };
+			return quaternionSandwich(quatInv, vector[0], vector[1], vector[2], quat);
 		}
 		else
 		{
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = quat * pin * quatInv;
-			return{ pout.x, pout.y, pout.z };
+			return quaternionSandwich(quat, vector[0], vector[1], vector[2], quatInv);
+		}
+	}
+
+	// Spherical linear interpolation between two unit quaternions along the shortest path, t in [0, 1]
+	inline vr::HmdQuaternion_t quaternionSlerp(const vr::HmdQuaternion_t& a, const vr::HmdQuaternion_t& b, double t)
+	{
+		double cosTheta = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+		double sign = 1.0;
+		if (cosTheta < 0.0)
+		{
+			cosTheta = -cosTheta;
+			sign = -1.0;
+		}
+		double wa, wb;
+		if (cosTheta > 0.9995)
+		{
+			// nearly identical orientations, fall back to normalized linear interpolation
+			wa = 1.0 - t;
+			wb = t * sign;
+			vr::HmdQuaternion_t result = {
+				wa * a.w + wb * b.w,
+				wa * a.x + wb * b.x,
+				wa * a.y + wb * b.y,
+				wa * a.z + wb * b.z
+			};
+			double norm = std::sqrt(result.w * result.w + result.x * result.x + result.y * result.y + result.z * result.z);
+			return { result.w / norm, result.x / norm, result.y / norm, result.z / norm };
+		}
+		double theta = std::acos(cosTheta);
+		double sinTheta = std::sin(theta);
+		wa = std::sin((1.0 - t) * theta) / sinTheta;
+		wb = std::sin(t * theta) / sinTheta * sign;
+		return {
+			wa * a.w + wb * b.w,
+			wa * a.x + wb * b.x,
+			wa * a.y + wb * b.y,
+			wa * a.z + wb * b.z
+		};
+	}
+
+	// Returns the matrix equivalent of quat * v * conjugate(quat).
+	// Uses the homogeneous form so that the result matches quaternionRotateVector() even for not perfectly normalized quaternions.
+	inline Matrix33d rotationMatrixFromQuaternion(const vr::HmdQuaternion_t& quat)
+	{
+		double ww = quat.w * quat.w;
+		double xx = quat.x * quat.x;
+		double yy = quat.y * quat.y;
+		double zz = quat.z * quat.z;
+		double xy = quat.x * quat.y;
+		double xz = quat.x * quat.z;
+		double yz = quat.y * quat.z;
+		double wx = quat.w * quat.x;
+		double wy = quat.w * quat.y;
+		double wz = quat.w * quat.z;
+		return { {
+			{ ww + xx - yy - zz, 2.0 * (xy - wz), 2.0 * (xz + wy) },
+			{ 2.0 * (xy + wz), ww - xx + yy - zz, 2.0 * (yz - wx) },
+			{ 2.0 * (xz - wy), 2.0 * (yz + wx), ww - xx - yy + zz }
+		} };
+	}
+
+	inline Matrix33d matMul33(const Matrix33d& a, const Matrix33d& b)
+	{
+		Matrix33d result;
+		for (unsigned i = 0; i < 3; i++)
+		{
+			for (unsigned j = 0; j < 3; j++)
+			{
+				result.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j];
+			}
+		}
+		return result;
+	}
+
+	inline vr::HmdVector3d_t matMul33(const Matrix33d& a, const vr::HmdVector3d_t& b)
+	{
+		return {
+			a.m[0][0] * b.v[0] + a.m[0][1] * b.v[1] + a.m[0][2] * b.v[2],
+			a.m[1][0] * b.v[0] + a.m[1][1] * b.v[1] + a.m[1][2] * b.v[2],
+			a.m[2][0] * b.v[0] + a.m[2][1] * b.v[1] + a.m[2][2] * b.v[2]
+		};
+	}
+
+	inline vr::HmdVector3d_t matMul33(const Matrix33d& a, const double(&b)[3])
+	{
+		return {
+			a.m[0][0] * b[0] + a.m[0][1] * b[1] + a.m[0][2] * b[2],
+			a.m[1][0] * b[0] + a.m[1][1] * b[1] + a.m[1][2] * b[2],
+			a.m[2][0] * b[0] + a.m[2][1] * b[1] + a.m[2][2] * b[2]
+		};
+	}
+
+	// Vector times matrix, i.e. multiplication with the transposed (= inverse for rotations) matrix
+	inline vr::HmdVector3d_t matMul33(const vr::HmdVector3d_t& a, const Matrix33d& b)
+	{
+		return {
+			a.v[0] * b.m[0][0] + a.v[1] * b.m[1][0] + a.v[2] * b.m[2][0],
+			a.v[0] * b.m[0][1] + a.v[1] * b.m[1][1] + a.v[2] * b.m[2][1],
+			a.v[0] * b.m[0][2] + a.v[1] * b.m[1][2] + a.v[2] * b.m[2][2]
+		};
+	}
+
+	inline vr::HmdVector3d_t matMul33(const double(&a)[3], const Matrix33d& b)
+	{
+		return {
+			a[0] * b.m[0][0] + a[1] * b.m[1][0] + a[2] * b.m[2][0],
+			a[0] * b.m[0][1] + a[1] * b.m[1][1] + a[2] * b.m[2][1],
+			a[0] * b.m[0][2] + a[1] * b.m[1][2] + a[2] * b.m[2][2]
+		};
+	}
+
+	// Batched form of matMul33(const Matrix33d&, const vr::HmdVector3d_t&), out may alias in.
+	inline void matMul33(const Matrix33d& a, const vr::HmdVector3d_t* in, vr::HmdVector3d_t* out, size_t count)
+	{
+#if defined(VRMATH_AVX)
+		__m256d col0 = _mm256_set_pd(0.0, a.m[2][0], a.m[1][0], a.m[0][0]);
+		__m256d col1 = _mm256_set_pd(0.0, a.m[2][1], a.m[1][1], a.m[0][1]);
+		__m256d col2 = _mm256_set_pd(0.0, a.m[2][2], a.m[1][2], a.m[0][2]);
+		__m256i storeMask = _mm256_set_epi64x(0, -1, -1, -1);
+		for (size_t i = 0; i < count; i++)
+		{
+			__m256d res = _mm256_mul_pd(col0, _mm256_set1_pd(in[i].v[0]));
+			res = _mm256_add_pd(res, _mm256_mul_pd(col1, _mm256_set1_pd(in[i].v[1])));
+			res = _mm256_add_pd(res, _mm256_mul_pd(col2, _mm256_set1_pd(in[i].v[2])));
+			_mm256_maskstore_pd(out[i].v, storeMask, res);
+		}
+#elif defined(VRMATH_SSE2)
+		__m128d col0 = _mm_set_pd(a.m[1][0], a.m[0][0]);
+		__m128d col1 = _mm_set_pd(a.m[1][1], a.m[0][1]);
+		__m128d col2 = _mm_set_pd(a.m[1][2], a.m[0][2]);
+		__m128d row2 = _mm_set_pd(a.m[2][1], a.m[2][0]);
+		for (size_t i = 0; i < count; i++)
+		{
+			__m128d vxy = _mm_loadu_pd(in[i].v);
+			double vz = in[i].v[2];
+			__m128d res = _mm_mul_pd(col0, _mm_set1_pd(in[i].v[0]));
+			res = _mm_add_pd(res, _mm_mul_pd(col1, _mm_set1_pd(in[i].v[1])));
+			res = _mm_add_pd(res, _mm_mul_pd(col2, _mm_set1_pd(vz)));
+			__m128d z = _mm_mul_pd(row2, vxy);
+			z = _mm_add_sd(z, _mm_unpackhi_pd(z, z));
+			_mm_storeu_pd(out[i].v, res);
+			out[i].v[2] = _mm_cvtsd_f64(z) + a.m[2][2] * vz;
+		}
+#else
+		for (size_t i = 0; i < count; i++)
+		{
+			out[i] = matMul33(a, in[i]);
 		}
+#endif
+	}
+
+	// Rotates count vectors, same result as calling quaternionRotateVector() on each of them.
+	// The quaternion is converted into a matrix once, so this pays off from about two vectors on.
+	inline void quaternionRotateVectors(const vr::HmdQuaternion_t& quat, const vr::HmdVector3d_t* in, vr::HmdVector3d_t* out, size_t count, bool reverse = false)
+	{
+		matMul33(rotationMatrixFromQuaternion(reverse ? quaternionConjugate(quat) : quat), in, out, count);
 	}
 
 	inline vr::HmdMatrix34_t matMul33(const vr::HmdMatrix34_t& a, const vr::HmdMatrix34_t& b)
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+
+#define POSE_RECORDING_VERSION 2
+
+namespace vrinputemulator
+{
+	// Binary pose stream written by the driver when pose recording is enabled.
+	//
+	// Layout: one PoseRecordingHeader followed by an unbounded sequence of PoseRecords.
+	// All records have the same size, so a recording can be indexed directly without parsing.
+	//
+	// vr::DriverPose_t has to be declared by the includer: by openvr_driver.h in the driver and its tools, by vrinputemulator.h
+	// in client code. Including openvr_driver.h here would clash with the copy in vrinputemulator.h.
+
+	static const char PoseRecordingMagic[8] = { 'V', 'R', 'I', 'E', 'P', 'O', 'S', 'E' };
+
+	struct PoseRecordingHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t recordSize;
+	};
+
+	struct PoseRecord
+	{
+		uint32_t deviceId;
+		uint32_t forwarded; // 0 when the pose has been swallowed by the driver
+		int64_t timestamp; // nanoseconds, see MonotonicClock
+		vr::DriverPose_t rawPose; // pose as reported by the device driver
+		vr::DriverPose_t compensatedPose; // pose as forwarded to SteamVR
+	};
+
+
+	// Read-only view of a pose recording.
+	// The file is memory-mapped, so arbitrarily long recordings can be replayed without loading them into memory.
+	class PoseRecordingReader
+	{
+	public:
+		PoseRecordingReader()
+		{
+		}
+		PoseRecordingReader(const std::string& filename)
+		{
+			open(filename);
+		}
+
+		void open(const std::string& filename)
+		{
+			_mapping = boost::interprocess::file_mapping(filename.c_str(), boost::interprocess::read_only);
+			_region = boost::interprocess::mapped_region(_mapping, boost::interprocess::read_only);
+			auto size = _region.get_size();
+			if (size < sizeof(PoseRecordingHeader))
+			{
+				throw std::runtime_error("Pose recording is truncated");
+			}
+			auto header = (const PoseRecordingHeader*)_region.get_address();
+			if (std::memcmp(header->magic, PoseRecordingMagic, sizeof(PoseRecordingMagic)) != 0)
+			{
+				throw std::runtime_error("Not a pose recording");
+			}
+			if (header->version != POSE_RECORDING_VERSION || header->recordSize != sizeof(PoseRecord))
+			{
+				throw std::runtime_error("Incompatible pose recording version");
+			}
+			_records = (const PoseRecord*)(header + 1);
+			// A recording that is still being written may end with a partial record
+			_recordCount = (size - sizeof(PoseRecordingHeader)) / sizeof(PoseRecord);
+		}
+
+		size_t size() const
+		{
+			return _recordCount;
+		}
+
+		const PoseRecord& operator[](size_t index) const
+		{
+			return _records[index];
+		}
+
+		const PoseRecord* begin() const
+		{
+			return _records;
+		}
+
+		const PoseRecord* end() const
+		{
+			return _records + _recordCount;
+		}
+
+	private:
+		boost::interprocess::file_mapping _mapping;
+		boost::interprocess::mapped_region _region;
+		const PoseRecord* _records = nullptr;
+		size_t _recordCount = 0;
+	};
+
+} // end namespace vrinputemulator
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <stdint.h>
+#include <atomic>
 #include <string>
-#include <future>
+#include <functional>
+#include <condition_variable>
 #include <mutex>
 #include <thread>
-#include <map>
+#include <vector>
 #include <memory>
 #include <random>
 #include <string>
@@ -84,7 +86,8 @@ namespace vr
 } // end namespace vr
 
 
-#include <ipc_protocol.h>
+#include <ipc_shm_channel.h>
+#include <ipc_stats.h>
 
 namespace vrinputemulator
 {
@@ -135,58 +138,228 @@ namespace vrinputemulator
 	};
 
 
+	// State of all devices known to the driver, see VRInputEmulator::getAllDeviceInfos()
+	struct AllDeviceInfos
+	{
+		MotionCompensationStatus motionCompensationStatus = MotionCompensationStatus::WaitingForZeroRef;
+		std::vector<DeviceInfo> devices;
+	};
+
+
+	// Everything needed to enable motion compensation, see VRInputEmulator::applyMotionCompensation()
+	struct MotionCompensationSettings
+	{
+		MotionCompensationVelAccMode velAccMode = MotionCompensationVelAccMode::Disabled;
+		double kalmanProcessNoise = 0.1;
+		double kalmanObservationNoise = 0.1;
+		double rotKalmanProcessNoise = 10.0; // angular velocity filter, (rad/s^2)^2
+		double rotKalmanObservationNoise = 0.5; // angular velocity filter, (rad/s)^2
+		unsigned movingAverageWindow = 3;
+	};
+
+
+	class VRInputEmulator;
+
+	// Result of an asynchronous request, see the *Async methods of VRInputEmulator. Used like a std::future, but the reply is kept in a
+	// slot VRInputEmulator preallocates, so a request does not allocate. Must not outlive the VRInputEmulator it came from.
+	template<typename T>
+	class AsyncReply
+	{
+	public:
+		AsyncReply()
+		{
+		}
+		AsyncReply(AsyncReply&& other);
+		AsyncReply& operator=(AsyncReply&& other);
+		AsyncReply(const AsyncReply&) = delete;
+		AsyncReply& operator=(const AsyncReply&) = delete;
+		~AsyncReply(); // the reply is dropped when it arrives
+
+		bool valid() const
+		{
+			return _owner != nullptr;
+		}
+		bool ready() const; // get() would not block
+		void wait() const;
+		// Waits for the reply, throws the same exceptions as the blocking calls. Afterwards valid() is false.
+		T get();
+
+	private:
+		friend class VRInputEmulator;
+		AsyncReply(VRInputEmulator* owner, uint32_t messageId, const char* errorPrefix) : _owner(owner), _messageId(messageId), _errorPrefix(errorPrefix)
+		{
+		}
+		void _release();
+
+		VRInputEmulator* _owner = nullptr;
+		uint32_t _messageId = 0;
+		const char* _errorPrefix = nullptr;
+	};
+
+	template<> void AsyncReply<void>::get();
+
+
 	class VRInputEmulator
 	{
 	public:
-		VRInputEmulator(const std::string& driverQueue = "driver_vrinputemulator.server_queue", const std::string& clientQueue = "driver_vrinputemulator.client_queue.");
+		VRInputEmulator(const std::string& driverQueue = "driver_vrinputemulator.server_queue", const std::string& clientQueue = "driver_vrinputemulator.client_queue.",
+			const std::string& driverDoorbell = "driver_vrinputemulator.server_doorbell", const std::string& clientChannel = "driver_vrinputemulator.client_channel.",
+			const std::string& driverStats = "driver_vrinputemulator.stats");
 		~VRInputEmulator();
 
+		// Requests throw vrinputemulator_connectionerror once the driver evicted this client (it stopped taking replies for several
+		// seconds), or when a reply takes longer than 30 seconds. isConnected() is false after an eviction, disconnect() cleans up.
 		void connect();
 		bool isConnected() const;
 		void disconnect();
 
+		// Use a shared memory channel instead of the message queues when the driver supports it (default: true).
+		// Only takes effect on the next connect().
+		void setSharedMemoryTransportEnabled(bool enabled)
+		{
+			_shmTransportEnabled = enabled;
+		}
+		bool isUsingSharedMemoryTransport() const
+		{
+			return _shmChannelActive;
+		}
+
+		// Requests sent between beginBatch() and endBatch() are handed to the driver together, as one message queue message or with
+		// a single doorbell signal on the shared memory channel. Batches can be nested, the outermost endBatch() sends them.
+		// Only use non-modal and asynchronous calls inside a batch, a blocking call would wait for a reply to a request not yet sent.
+		void beginBatch();
+		void endBatch();
+
 		void ping(bool modal = true, bool enableReply = false);
 
+		// Copies the live statistics the driver publishes in shared memory. No ipc round trip, cheap enough to be called at a high rate.
+		// Throws vrinputemulator_connectionerror when not connected or the driver does not publish statistics.
+		void getDriverStats(DriverStats& stats);
+
+		// Adds the latency histograms of the TrackedDevicePoseUpdated hook to the given histograms: processing is the time spent
+		// in the driver, steamvr the time spent forwarding the pose to SteamVR. Histograms of all devices are merged when deviceId
+		// is k_unTrackedDeviceIndexInvalid. Same requirements as getDriverStats().
+		void getPoseHookHistograms(LatencyHistogram& processing, LatencyHistogram& steamvr, uint32_t deviceId = vr::k_unTrackedDeviceIndexInvalid);
+		void resetPoseHookHistograms(bool modal = true);
+
+		// Lets the driver write the profiling zones it recorded as Chrome trace JSON (chrome://tracing, Perfetto) to a file in its log
+		// directory. Only a bare file name is accepted, anything with a path fails with InvalidParameter.
+		// Fails with InvalidOperation when the driver was built without VRINPUTEMULATOR_PROFILING.
+		void writeDriverTrace(const std::string& filename);
+
+		// Receive events pushed by the driver. eventMask is a combination of DriverEventType bits, 0 unsubscribes.
+		// The callback is called from the ipc thread and should return quickly.
+		void subscribeDriverEvents(uint32_t eventMask, std::function<void(const DriverEvent&)> callback);
+
 		void openvrVendorSpecificEvent(uint32_t deviceId, vr::EVREventType eventType, const vr::VREvent_Data_t& eventData, double timeOffset = 0.0);
 
 		void getDeviceInfo(uint32_t deviceId, DeviceInfo& info);
+		void getAllDeviceInfos(AllDeviceInfos& infos); // one round trip for all devices
 		void setDeviceNormalMode(uint32_t deviceId, bool modal = true);
 
 		void setDeviceMotionCompensationMode(uint32_t deviceId, MotionCompensationVelAccMode velAccMode = MotionCompensationVelAccMode::Disabled, bool modal = true);
 		void setMotionVelAccCompensationMode(MotionCompensationVelAccMode velAccMode, bool modal = true);
 		void setMotionCompensationKalmanProcessNoise(double variance, bool modal = true);
 		void setMotionCompensationKalmanObservationNoise(double variance, bool modal = true);
+		void setMotionCompensationRotKalmanNoise(double processVariance, double observationVariance, bool modal = true); // angular velocity filter
 		void setMotionCompensationMovingAverageWindow(unsigned window, bool modal = true);
+		// Sets all motion compensation settings and puts the device into motion compensation mode with a single request.
+		// The driver switches to the new settings at once, pose updates never see a partially applied configuration.
+		void applyMotionCompensation(uint32_t deviceId, const MotionCompensationSettings& settings, bool modal = true);
+
+		// Asynchronous variants: the request is sent right away, the returned AsyncReply becomes ready when the reply arrives.
+		// get() throws the same exceptions as the blocking calls. Up to 256 requests can wait for their replies at the same time.
+		AsyncReply<void> pingAsync();
+		AsyncReply<DeviceInfo> getDeviceInfoAsync(uint32_t deviceId);
+		AsyncReply<AllDeviceInfos> getAllDeviceInfosAsync();
+		AsyncReply<void> setDeviceNormalModeAsync(uint32_t deviceId);
+		AsyncReply<void> setDeviceMotionCompensationModeAsync(uint32_t deviceId, MotionCompensationVelAccMode velAccMode = MotionCompensationVelAccMode::Disabled);
+		AsyncReply<void> setMotionVelAccCompensationModeAsync(MotionCompensationVelAccMode velAccMode);
+		AsyncReply<void> setMotionCompensationKalmanProcessNoiseAsync(double variance);
+		AsyncReply<void> setMotionCompensationKalmanObservationNoiseAsync(double variance);
+		AsyncReply<void> setMotionCompensationRotKalmanNoiseAsync(double processVariance, double observationVariance);
+		AsyncReply<void> setMotionCompensationMovingAverageWindowAsync(unsigned window);
+		AsyncReply<void> applyMotionCompensationAsync(uint32_t deviceId, const MotionCompensationSettings& settings);
 
 	private:
-		std::recursive_mutex _mutex;
+		template<typename T> friend class AsyncReply;
+
 		uint32_t m_clientId = 0;
 
 		bool _ipcThreadRunning = false;
 		volatile bool _ipcThreadStop = false;
 		std::thread _ipcThread;
 		static void _ipcThreadFunc(VRInputEmulator* _this);
-
-		std::random_device _ipcRandomDevice;
+		void _ipcSend(const ipc::Request& message);
+		void _ipcSendExpectingReply(ipc::Request& message, uint32_t& messageId);
+		AsyncReply<void> _ipcRequestAsync(ipc::Request& message, uint32_t& messageId, bool wantReply, const char* errorPrefix);
+		static void _checkReplyStatus(const ipc::Reply& resp, const char* errorPrefix);
+		static void _decodeReply(const ipc::Reply& resp, DeviceInfo& info);
+		static void _decodeReply(const ipc::Reply& resp, AllDeviceInfos& infos);
+
+		AsyncReply<void> _setDeviceNormalMode(uint32_t deviceId, bool wantReply);
+		AsyncReply<void> _setDeviceMotionCompensationMode(uint32_t deviceId, MotionCompensationVelAccMode velAccMode, bool wantReply);
+		AsyncReply<void> _applyMotionCompensation(uint32_t deviceId, const MotionCompensationSettings& settings, bool wantReply);
+		AsyncReply<void> _setMotionCompensationProperties(const ipc::Request_DeviceManipulation_SetMotionCompensationProperties& properties, bool wantReply);
+		void _ipcDispatch(const ipc::Reply& message);
+		void _ipcFlushBatch();
+		void _ipcWakeThread();
+		void _shmRelease();
+		void _ipcClose();
+		std::mutex _ipcSendMutex; // also guards the batch state
+		unsigned _ipcBatchDepth = 0;
+		bool _ipcBatchDoorbellPending = false;
+		std::unique_ptr<ipc::FrameWriter<ipc::Request>> _ipcBatch;
+
+		std::random_device _ipcRandomDevice; // only used for endpoint names
 		std::uniform_int_distribution<uint32_t> _ipcRandomDist;
-		struct _ipcPromiseMapEntry
+
+		// Requests waiting for a reply. Message ids are handed out sequentially (0 means "no reply"), skipping ids whose slot is
+		// still taken by an older request. The slot of a message id is fixed, so the ipc thread finds it without searching.
+		// The ipc thread copies the reply into the slot, the requester waits on the slot's condition variable and frees it.
+		struct _ipcReplySlot
 		{
-			_ipcPromiseMapEntry() : isValid(false)
-			{
-			}
-			_ipcPromiseMapEntry(std::promise<ipc::Reply>&& _promise, bool isValid = true)
-				: promise(std::move(_promise)), isValid(isValid)
-			{
-			}
-			bool isValid;
-			std::promise<ipc::Reply> promise;
+			uint32_t messageId = 0; // 0 .. free
+			bool wantsReply = false; // false .. the reply is dropped when it arrives
+			std::atomic<bool> replied = { false };
+			bool connectionLost = false; // "replied" by _ipcFailPendingReplies()
+			std::condition_variable repliedCondition;
+			ipc::Reply reply;
 		};
-		std::map<uint32_t, _ipcPromiseMapEntry> _ipcPromiseMap;
+		static const uint32_t _ipcReplySlotCount = 256;
+		// longer than the driver takes for a deferred reply, see IpcShmCommunicator::_pendingOperationTimeout
+		static const unsigned _ipcReplyTimeoutSeconds = 30;
+		static const unsigned _ipcSendTimeoutSeconds = 10; // waiting for space in a full request ring
+		std::atomic<bool> _ipcConnectionLost = { false }; // evicted by the driver, set with _ipcReplySlotsMutex held
+		std::mutex _ipcReplySlotsMutex;
+		std::unique_ptr<_ipcReplySlot[]> _ipcReplySlots; // allocated once, too large for the stack
+		uint32_t _ipcNextMessageId = 1;
+		uint32_t _ipcAcquireReplySlot(bool wantsReply);
+		void _ipcReleaseReplySlot(uint32_t messageId);
+		void _ipcAbandonReply(uint32_t messageId);
+		bool _ipcReplyArrived(uint32_t messageId);
+		void _ipcWaitReply(uint32_t messageId);
+		void _ipcTakeReply(uint32_t messageId, ipc::Reply& reply);
+		void _ipcFailPendingReplies();
+
+		std::mutex _eventCallbackMutex;
+		std::function<void(const DriverEvent&)> _eventCallback;
+
 		std::string _ipcServerQueueName;
 		std::string _ipcClientQueueName;
 		boost::interprocess::message_queue* _ipcServerQueue = nullptr;
 		boost::interprocess::message_queue* _ipcClientQueue = nullptr;
 
+		bool _shmTransportEnabled = true;
+		std::atomic<bool> _shmChannelActive = { false };
+		std::string _shmDoorbellName;
+		std::string _shmChannelName;
+		std::unique_ptr<ipc::ShmMapping<ipc::ShmDoorbellBlock>> _shmDoorbell;
+		std::unique_ptr<ipc::ShmMapping<ipc::ShmChannelBlock>> _shmChannel;
+
+		std::string _statsPageName;
+		std::unique_ptr<ipc::ShmMapping<ipc::ShmStatsBlock>> _statsPage; // read-only
+
 	};
 
 } // end namespace vrinputemulator
\ No newline at end of file
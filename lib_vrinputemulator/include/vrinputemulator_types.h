@@ -10,6 +10,10 @@ namespace vrinputemulator
 	static const char* const vrsettings_overrideHmdModel_string = "overrideHmdModel";
 	static const char* const vrsettings_overrideHmdTrackingSystem_string = "overrideHmdTrackingSystem";
 	static const char* const vrsettings_genericTrackerFakeController_bool = "genericTrackerFakeController";
+	static const char* const vrsettings_poseRecordingEnabled_bool = "poseRecordingEnabled";
+	static const char* const vrsettings_poseRecordingFile_string = "poseRecordingFile";
+	static const char* const vrsettings_motionCompensationRefPrediction_bool = "motionCompensationRefPrediction";
+	static const char* const vrsettings_motionCompensationRefPredictionMaxMs_float = "motionCompensationRefPredictionMaxMs";
 
 	enum class VirtualDeviceType : uint32_t
 	{
@@ -48,4 +52,29 @@ namespace vrinputemulator
 		KalmanFilter = 4
 	};
 
+	enum class MotionCompensationStatus : uint32_t
+	{
+		WaitingForZeroRef = 0,
+		Running = 1,
+		MotionRefNotTracking = 2
+	};
+
+	// Events the driver pushes to subscribed clients. The values are bits, so they can be combined into a subscription mask.
+	enum class DriverEventType : uint32_t
+	{
+		None = 0,
+		MotionCompensationStatusChanged = 1 << 0,
+		DeviceModeChanged = 1 << 1,
+		DeviceAdded = 1 << 2
+	};
+
+	struct DriverEvent
+	{
+		DriverEventType type;
+		uint32_t deviceId; // k_unTrackedDeviceIndexInvalid when the event is not about a device
+		vr::ETrackedDeviceClass deviceClass; // DeviceAdded
+		int deviceMode; // DeviceModeChanged
+		MotionCompensationStatus motionCompensationStatus; // MotionCompensationStatusChanged
+	};
+
 } // end namespace vrinputemulator
\ No newline at end of file
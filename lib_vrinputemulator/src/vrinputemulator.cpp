@@ -1,8 +1,9 @@
 #include <vrinputemulator.h>
-#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <cstdlib>
 #include <functional>
 #include <iostream>
+#include <cstring>
+#include <chrono>
 #include <config.h>
 
 
@@ -13,6 +14,17 @@
 #define WRITELOG(level, txt) std::cerr << txt;
 #endif
 
+#ifndef _MSC_VER
+// strncpy_s is only provided by the MSVC runtime, mirrors the array overload used below
+template<size_t Size>
+static void strncpy_s(char (&dest)[Size], const char* src, size_t count)
+{
+	size_t n = count < Size - 1 ? count : Size - 1;
+	strncpy(dest, src, n);
+	dest[n] = '\0';
+}
+#endif
+
 
 
 namespace vrinputemulator
@@ -21,36 +33,41 @@ namespace vrinputemulator
 	void VRInputEmulator::_ipcThreadFunc(VRInputEmulator* _this)
 	{
 		_this->_ipcThreadRunning = true;
+		std::vector<uint8_t> frame(ipc::MaxFrameSize);
 		while (!_this->_ipcThreadStop)
 		{
 			try
 			{
+				// Both receive calls block until something arrives, see _ipcWakeThread()
 				ipc::Reply message;
-				uint64_t recv_size;
-				unsigned priority;
-				boost::posix_time::ptime timeout = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(50);
-				if (_this->_ipcClientQueue->timed_receive(&message, sizeof(ipc::Reply), recv_size, priority, timeout))
+				if (_this->_shmChannelActive)
 				{
-					if (recv_size == sizeof(ipc::Reply))
+					// the driver posts the semaphore once per reply
+					auto& channel = *_this->_shmChannel;
+					channel->repliesAvailable.wait();
+					if (channel->replies.tryPop(message))
+					{
+						_this->_ipcDispatch(message);
+					}
+					else if (channel->evicted)
 					{
-						std::lock_guard<std::recursive_mutex> lock(_this->_mutex);
-						auto i = _this->_ipcPromiseMap.find(message.messageId);
-						if (i != _this->_ipcPromiseMap.end())
-						{
-							if (i->second.isValid)
-							{
-								i->second.promise.set_value(message);
-							}
-							else
-							{
-								_this->_ipcPromiseMap.erase(i); // nobody wants it, so we delete it
-							}
-						}
+						_this->_ipcFailPendingReplies();
 					}
 				}
 				else
 				{
-					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					uint64_t recv_size;
+					unsigned priority;
+					_this->_ipcClientQueue->receive(frame.data(), frame.size(), recv_size, priority);
+					ipc::FrameReader<ipc::Reply> reader(frame.data(), (size_t)recv_size);
+					while (reader.next(message))
+					{
+						_this->_ipcDispatch(message);
+					}
+					if (!reader.valid())
+					{
+						WRITELOG(ERROR, "Error in ipc receive loop: received malformed frame" << std::endl);
+					}
 				}
 			}
 			catch (std::exception & ex)
@@ -61,9 +78,337 @@ namespace vrinputemulator
 		_this->_ipcThreadRunning = false;
 	}
 
+	// Hands a received reply to whoever waits for it
+	void VRInputEmulator::_ipcDispatch(const ipc::Reply& message)
+	{
+		if (message.type == ipc::ReplyType::IPC_Event)
+		{
+			std::lock_guard<std::mutex> lock(_eventCallbackMutex);
+			if (_eventCallback)
+			{
+				_eventCallback(message.msg.ipc_Event);
+			}
+		}
+		else if (message.type != ipc::ReplyType::None && message.messageId != 0) // None is only used to wake up the ipc thread
+		{
+			std::lock_guard<std::mutex> lock(_ipcReplySlotsMutex);
+			auto& slot = _ipcReplySlots[message.messageId % _ipcReplySlotCount];
+			if (slot.messageId == message.messageId && !slot.replied.load(std::memory_order_relaxed))
+			{
+				if (slot.wantsReply)
+				{
+					slot.reply = message;
+					slot.replied.store(true, std::memory_order_release);
+					slot.repliedCondition.notify_all();
+				}
+				else
+				{
+					slot.messageId = 0; // nobody waits for it
+				}
+			}
+		}
+	}
+
+	// Sends a request over the shared memory channel when the driver accepted it, otherwise over the message queue
+	void VRInputEmulator::_ipcSend(const ipc::Request& message)
+	{
+		std::lock_guard<std::mutex> lock(_ipcSendMutex); // the request ring has a single producer
+		if (_ipcConnectionLost)
+		{
+			throw vrinputemulator_connectionerror("Connection closed by the driver.");
+		}
+		if (_shmChannelActive)
+		{
+			auto& channel = *_shmChannel;
+			bool doorbellRung = false;
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(_ipcSendTimeoutSeconds);
+			while (!channel->requests.tryPush(message, ipc::messageSize(message)))
+			{
+				// ring is full, wait for the driver like a full message queue would, unless it gave up on us
+				if (channel->evicted || channel->closed)
+				{
+					_ipcFailPendingReplies();
+					throw vrinputemulator_connectionerror("Connection closed by the driver.");
+				}
+				if (!doorbellRung)
+				{
+					(*_shmDoorbell)->requestsAvailable.post(); // the driver may not know about a batch yet
+					doorbellRung = true;
+				}
+				else if (std::chrono::steady_clock::now() > deadline)
+				{
+					throw vrinputemulator_connectionerror("Driver does not accept requests.");
+				}
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+			if (_ipcBatchDepth > 0)
+			{
+				_ipcBatchDoorbellPending = true;
+			}
+			else
+			{
+				(*_shmDoorbell)->requestsAvailable.post();
+			}
+		}
+		else if (_ipcBatchDepth > 0)
+		{
+			if (!_ipcBatch->append(message))
+			{
+				_ipcFlushBatch();
+				_ipcBatch->append(message);
+			}
+		}
+		else
+		{
+			ipc::FrameWriter<ipc::Request> frame;
+			frame.append(message);
+			_ipcServerQueue->send(frame.data(), frame.size(), 0);
+		}
+	}
+
+	// Expects _ipcSendMutex to be held
+	void VRInputEmulator::_ipcFlushBatch()
+	{
+		if (_ipcBatchDoorbellPending)
+		{
+			(*_shmDoorbell)->requestsAvailable.post();
+			_ipcBatchDoorbellPending = false;
+		}
+		if (_ipcBatch && !_ipcBatch->empty())
+		{
+			_ipcServerQueue->send(_ipcBatch->data(), _ipcBatch->size(), 0);
+			_ipcBatch->clear();
+		}
+	}
+
+	void VRInputEmulator::beginBatch()
+	{
+		std::lock_guard<std::mutex> lock(_ipcSendMutex);
+		if (!_ipcBatch)
+		{
+			_ipcBatch.reset(new ipc::FrameWriter<ipc::Request>());
+		}
+		_ipcBatchDepth++;
+	}
+
+	void VRInputEmulator::endBatch()
+	{
+		std::lock_guard<std::mutex> lock(_ipcSendMutex);
+		if (_ipcBatchDepth > 0 && --_ipcBatchDepth == 0 && _ipcServerQueue)
+		{
+			_ipcFlushBatch();
+		}
+	}
+
+	// Assigns a message id, reserves its reply slot and sends the request. The reply is picked up with _ipcTakeReply().
+	void VRInputEmulator::_ipcSendExpectingReply(ipc::Request& message, uint32_t& messageId)
+	{
+		if (!_ipcServerQueue)
+		{
+			throw vrinputemulator_connectionerror("No active connection.");
+		}
+		messageId = _ipcAcquireReplySlot(true);
+		try
+		{
+			_ipcSend(message);
+		}
+		catch (...)
+		{
+			_ipcReleaseReplySlot(messageId);
+			throw;
+		}
+	}
+
+	// Reserves the reply slot of the next message id whose slot is free. Without wantsReply the reply is dropped when it arrives.
+	uint32_t VRInputEmulator::_ipcAcquireReplySlot(bool wantsReply)
+	{
+		std::lock_guard<std::mutex> lock(_ipcReplySlotsMutex);
+		if (_ipcConnectionLost)
+		{
+			throw vrinputemulator_connectionerror("Connection closed by the driver.");
+		}
+		for (uint32_t i = 0; i < _ipcReplySlotCount; ++i)
+		{
+			auto messageId = _ipcNextMessageId;
+			_ipcNextMessageId = messageId + 1 != 0 ? messageId + 1 : 1;
+			auto& slot = _ipcReplySlots[messageId % _ipcReplySlotCount];
+			if (slot.messageId == 0)
+			{
+				slot.messageId = messageId;
+				slot.wantsReply = wantsReply;
+				slot.connectionLost = false;
+				slot.replied.store(false, std::memory_order_relaxed);
+				return messageId;
+			}
+		}
+		throw vrinputemulator_exception("Too many requests waiting for a reply.");
+	}
+
+	// Frees the slot whether or not the reply has arrived, for requests that were never sent
+	void VRInputEmulator::_ipcReleaseReplySlot(uint32_t messageId)
+	{
+		std::lock_guard<std::mutex> lock(_ipcReplySlotsMutex);
+		auto& slot = _ipcReplySlots[messageId % _ipcReplySlotCount];
+		if (slot.messageId == messageId)
+		{
+			slot.messageId = 0;
+		}
+	}
+
+	// Frees the slot now if the reply is already there, otherwise when it arrives
+	void VRInputEmulator::_ipcAbandonReply(uint32_t messageId)
+	{
+		std::lock_guard<std::mutex> lock(_ipcReplySlotsMutex);
+		auto& slot = _ipcReplySlots[messageId % _ipcReplySlotCount];
+		if (slot.messageId == messageId)
+		{
+			if (slot.replied.load(std::memory_order_relaxed))
+			{
+				slot.messageId = 0;
+			}
+			else
+			{
+				slot.wantsReply = false;
+			}
+		}
+	}
+
+	bool VRInputEmulator::_ipcReplyArrived(uint32_t messageId)
+	{
+		return _ipcReplySlots[messageId % _ipcReplySlotCount].replied.load(std::memory_order_acquire);
+	}
+
+	// Returns when the reply arrived or after _ipcReplyTimeoutSeconds
+	void VRInputEmulator::_ipcWaitReply(uint32_t messageId)
+	{
+		std::unique_lock<std::mutex> lock(_ipcReplySlotsMutex);
+		auto& slot = _ipcReplySlots[messageId % _ipcReplySlotCount];
+		slot.repliedCondition.wait_for(lock, std::chrono::seconds(_ipcReplyTimeoutSeconds), [&slot]() { return slot.replied.load(std::memory_order_relaxed); });
+	}
+
+	// Waits for the reply, copies it and frees the slot
+	void VRInputEmulator::_ipcTakeReply(uint32_t messageId, ipc::Reply& reply)
+	{
+		std::unique_lock<std::mutex> lock(_ipcReplySlotsMutex);
+		auto& slot = _ipcReplySlots[messageId % _ipcReplySlotCount];
+		if (!slot.repliedCondition.wait_for(lock, std::chrono::seconds(_ipcReplyTimeoutSeconds), [&slot]() { return slot.replied.load(std::memory_order_relaxed); }))
+		{
+			slot.wantsReply = false; // freed when the reply arrives after all
+			throw vrinputemulator_connectionerror("Driver did not reply in time.");
+		}
+		reply = slot.reply;
+		slot.messageId = 0;
+		if (slot.connectionLost)
+		{
+			throw vrinputemulator_connectionerror("Connection closed by the driver.");
+		}
+	}
+
+	// The driver evicted this client and will not answer anymore: wakes all requests still waiting for a reply with a connection error.
+	// Requests made afterwards fail right away.
+	void VRInputEmulator::_ipcFailPendingReplies()
+	{
+		std::lock_guard<std::mutex> lock(_ipcReplySlotsMutex);
+		_ipcConnectionLost = true;
+		for (uint32_t i = 0; i < _ipcReplySlotCount; ++i)
+		{
+			auto& slot = _ipcReplySlots[i];
+			if (slot.messageId != 0 && !slot.replied.load(std::memory_order_relaxed))
+			{
+				if (slot.wantsReply)
+				{
+					slot.connectionLost = true;
+					slot.replied.store(true, std::memory_order_release);
+					slot.repliedCondition.notify_all();
+				}
+				else
+				{
+					slot.messageId = 0;
+				}
+			}
+		}
+	}
+
+	// Sends the request, the returned AsyncReply only reports the reply status (by throwing from get()).
+	// Without wantReply the driver is told not to reply at all and an invalid AsyncReply is returned.
+	AsyncReply<void> VRInputEmulator::_ipcRequestAsync(ipc::Request& message, uint32_t& messageId, bool wantReply, const char* errorPrefix)
+	{
+		if (!wantReply)
+		{
+			if (!_ipcServerQueue)
+			{
+				throw vrinputemulator_connectionerror("No active connection.");
+			}
+			messageId = 0;
+			_ipcSend(message);
+			return AsyncReply<void>();
+		}
+		_ipcSendExpectingReply(message, messageId);
+		return AsyncReply<void>(this, messageId, errorPrefix);
+	}
+
+	void VRInputEmulator::_checkReplyStatus(const ipc::Reply& resp, const char* errorPrefix)
+	{
+		if (resp.status == ipc::ReplyStatus::Ok)
+		{
+			return;
+		}
+		std::stringstream ss;
+		ss << errorPrefix;
+		if (resp.status == ipc::ReplyStatus::InvalidId)
+		{
+			ss << "Invalid device id";
+			throw vrinputemulator_invalidid(ss.str(), (int)resp.status);
+		}
+		else if (resp.status == ipc::ReplyStatus::NotFound)
+		{
+			ss << "Device not found";
+			throw vrinputemulator_notfound(ss.str(), (int)resp.status);
+		}
+		else if (resp.status == ipc::ReplyStatus::InvalidParameter)
+		{
+			ss << "Invalid parameter";
+			throw vrinputemulator_exception(ss.str(), (int)resp.status);
+		}
+		else
+		{
+			ss << "Error code " << (int)resp.status;
+			throw vrinputemulator_exception(ss.str(), (int)resp.status);
+		}
+	}
+
+	// Wakes up the ipc thread so it sees a changed stop flag or transport.
+	// Both transports are signalled because the thread may still be blocked on the one that was active before.
+	void VRInputEmulator::_ipcWakeThread()
+	{
+		if (_shmChannel)
+		{
+			(*_shmChannel)->repliesAvailable.post();
+		}
+		ipc::Reply wakeup(ipc::ReplyType::None);
+		wakeup.messageId = 0;
+		ipc::FrameWriter<ipc::Reply> frame;
+		frame.append(wakeup);
+		_ipcClientQueue->try_send(frame.data(), frame.size(), 0); // a full queue wakes the thread anyway
+	}
+
+	void VRInputEmulator::_shmRelease()
+	{
+		_shmChannelActive = false;
+		if (_shmChannel)
+		{
+			(*_shmChannel)->closed = 1;
+			_shmChannel.reset();
+		}
+		_shmDoorbell.reset();
+	}
 
-	VRInputEmulator::VRInputEmulator(const std::string& serverQueue, const std::string& clientQueue) : _ipcServerQueueName(serverQueue), _ipcClientQueueName(clientQueue)
+
+	VRInputEmulator::VRInputEmulator(const std::string& serverQueue, const std::string& clientQueue, const std::string& serverDoorbell, const std::string& clientChannel,
+		const std::string& serverStats)
+		: _ipcServerQueueName(serverQueue), _ipcClientQueueName(clientQueue), _shmDoorbellName(serverDoorbell), _shmChannelName(clientChannel), _statsPageName(serverStats)
 	{
+		_ipcReplySlots.reset(new _ipcReplySlot[_ipcReplySlotCount]);
 	}
 
 	VRInputEmulator::~VRInputEmulator()
@@ -73,7 +418,7 @@ namespace vrinputemulator
 
 	bool VRInputEmulator::isConnected() const
 	{
-		return _ipcServerQueue != nullptr;
+		return _ipcServerQueue != nullptr && !_ipcConnectionLost;
 	}
 
 	void VRInputEmulator::connect()
@@ -102,7 +447,7 @@ namespace vrinputemulator
 					boost::interprocess::create_only,
 					_ipcClientQueueName.c_str(),
 					100,					//max message number
-					sizeof(ipc::Reply)    //max message size
+					ipc::MaxFrameSize    //max message size
 				);
 			}
 			catch (std::exception & e)
@@ -114,36 +459,74 @@ namespace vrinputemulator
 				ss << "Could not open client-side message queue: " << e.what();
 				throw vrinputemulator_connectionerror(ss.str());
 			}
+			// Create shared memory channel (optional, the message queues are used when this fails or the driver rejects it)
+			if (_shmTransportEnabled)
+			{
+				try
+				{
+					_shmDoorbell = ipc::ShmMapping<ipc::ShmDoorbellBlock>::open(_shmDoorbellName);
+					_shmChannelName += std::to_string(_ipcRandomDist(_ipcRandomDevice));
+					_shmChannel = ipc::ShmMapping<ipc::ShmChannelBlock>::create(_shmChannelName);
+				}
+				catch (std::exception & e)
+				{
+					_shmRelease();
+					WRITELOG(WARNING, "Could not set up shared memory channel, using message queues: " << e.what() << std::endl);
+				}
+			}
+			// Map statistics page (optional)
+			try
+			{
+				_statsPage = ipc::ShmMapping<ipc::ShmStatsBlock>::open(_statsPageName, true);
+			}
+			catch (std::exception & e)
+			{
+				_statsPage.reset();
+				WRITELOG(WARNING, "Could not map driver statistics: " << e.what() << std::endl);
+			}
 			// Start ipc thread
+			_ipcConnectionLost = false;
 			_ipcThreadStop = false;
 			_ipcThread = std::thread(_ipcThreadFunc, this);
 			// Send ClientConnect message to server
 			ipc::Request message(ipc::RequestType::IPC_ClientConnect);
-			auto messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.ipc_ClientConnect.messageId = messageId;
 			message.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
 			strncpy_s(message.msg.ipc_ClientConnect.queueName, _ipcClientQueueName.c_str(), 127);
 			message.msg.ipc_ClientConnect.queueName[127] = '\0';
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
+			if (_shmChannel)
+			{
+				strncpy_s(message.msg.ipc_ClientConnect.shmChannelName, _shmChannelName.c_str(), 127);
+				message.msg.ipc_ClientConnect.shmChannelName[127] = '\0';
+			}
+			else
 			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+				message.msg.ipc_ClientConnect.shmChannelName[0] = '\0';
 			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
 			// Wait for response
-			auto resp = respFuture.get();
+			ipc::Reply resp;
+			try
+			{
+				_ipcSendExpectingReply(message, message.msg.ipc_ClientConnect.messageId);
+				_ipcTakeReply(message.msg.ipc_ClientConnect.messageId, resp);
+			}
+			catch (...)
+			{
+				_ipcClose();
+				throw;
+			}
 			m_clientId = resp.msg.ipc_ClientConnect.clientId;
+			if (resp.status == ipc::ReplyStatus::Ok && resp.msg.ipc_ClientConnect.shmChannelAccepted && _shmChannel)
+			{
+				_shmChannelActive = true;
+				_ipcWakeThread(); // the thread is still waiting on the client queue
+			}
+			else
 			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
+				_shmRelease();
 			}
 			if (resp.status != ipc::ReplyStatus::Ok)
 			{
-				delete _ipcServerQueue;
-				_ipcServerQueue = nullptr;
-				delete _ipcClientQueue;
-				_ipcClientQueue = nullptr;
+				_ipcClose();
 				std::stringstream ss;
 				ss << "Connection rejected by server: ";
 				if (resp.status == ipc::ReplyStatus::InvalidVersion)
@@ -164,89 +547,63 @@ namespace vrinputemulator
 	{
 		if (_ipcServerQueue)
 		{
-// Send disconnect message (so the server can free resources)
-			ipc::Request message(ipc::RequestType::IPC_ClientDisconnect);
-			auto messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.ipc_ClientDisconnect.clientId = m_clientId;
-			message.msg.ipc_ClientDisconnect.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			m_clientId = resp.msg.ipc_ClientConnect.clientId;
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			// Stop ipc thread
-			if (_ipcThreadRunning)
-			{
-				_ipcThreadStop = true;
-				_ipcThread.join();
-			}
-			// delete message queues
-			if (_ipcServerQueue)
 			{
-				delete _ipcServerQueue;
-				_ipcServerQueue = nullptr;
+				// an unfinished batch would hold back the disconnect message
+				std::lock_guard<std::mutex> lock(_ipcSendMutex);
+				_ipcBatchDepth = 0;
+				_ipcFlushBatch();
 			}
-			if (_ipcClientQueue)
+// Send disconnect message (so the server can free resources)
+			if (!_ipcConnectionLost)
 			{
-				delete _ipcClientQueue;
-				_ipcClientQueue = nullptr;
+				try
+				{
+					ipc::Request message(ipc::RequestType::IPC_ClientDisconnect);
+					message.msg.ipc_ClientDisconnect.clientId = m_clientId;
+					ipc::Reply resp;
+					_ipcSendExpectingReply(message, message.msg.ipc_ClientDisconnect.messageId);
+					_ipcTakeReply(message.msg.ipc_ClientDisconnect.messageId, resp);
+				}
+				catch (vrinputemulator_connectionerror&)
+				{
+					// evicted meanwhile or the driver is gone, either way there is nobody to tell
+				}
 			}
+			m_clientId = 0;
+			_ipcClose();
 		}
 	}
 
+	// Stops the ipc thread and closes all transports
+	void VRInputEmulator::_ipcClose()
+	{
+		_ipcThreadStop = true;
+		_ipcWakeThread();
+		if (_ipcThread.joinable())
+		{
+			_ipcThread.join();
+		}
+		_shmRelease();
+		_statsPage.reset();
+		delete _ipcServerQueue;
+		_ipcServerQueue = nullptr;
+		delete _ipcClientQueue;
+		_ipcClientQueue = nullptr;
+	}
+
 	void VRInputEmulator::ping(bool modal, bool enableReply)
 	{
-		if (_ipcServerQueue)
+		if (modal)
+		{
+			pingAsync().get();
+		}
+		else if (_ipcServerQueue)
 		{
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			uint64_t nonce = _ipcRandomDist(_ipcRandomDevice);
 			ipc::Request message(ipc::RequestType::IPC_Ping);
 			message.msg.ipc_Ping.clientId = m_clientId;
-			message.msg.ipc_Ping.messageId = messageId;
-			message.msg.ipc_Ping.nonce = nonce;
-			if (modal)
-			{
-				std::promise<ipc::Reply> respPromise;
-				auto respFuture = respPromise.get_future();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-				}
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				auto resp = respFuture.get();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.erase(messageId);
-				}
-				if (resp.status != ipc::ReplyStatus::Ok)
-				{
-					std::stringstream ss;
-					ss << "Error while pinging server: Error code " << (int)resp.status;
-					throw vrinputemulator_exception(ss.str());
-				}
-			}
-			else
-			{
-				if (enableReply)
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					message.msg.ipc_Ping.messageId = messageId;
-					_ipcPromiseMap.insert({ messageId, _ipcPromiseMapEntry() });
-				}
-				else
-				{
-					message.msg.ipc_Ping.messageId = 0;
-				}
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			}
+			message.msg.ipc_Ping.messageId = enableReply ? _ipcAcquireReplySlot(false) : 0;
+			message.msg.ipc_Ping.nonce = message.timestamp;
+			_ipcSend(message);
 		}
 		else
 		{
@@ -254,6 +611,75 @@ namespace vrinputemulator
 		}
 	}
 
+	void VRInputEmulator::getDriverStats(DriverStats& stats)
+	{
+		if (!_statsPage)
+		{
+			throw vrinputemulator_connectionerror("No driver statistics available.");
+		}
+		(*_statsPage)->copyTo(stats);
+	}
+
+	void VRInputEmulator::getPoseHookHistograms(LatencyHistogram& processing, LatencyHistogram& steamvr, uint32_t deviceId)
+	{
+		if (!_statsPage)
+		{
+			throw vrinputemulator_connectionerror("No driver statistics available.");
+		}
+		for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; ++id)
+		{
+			if (deviceId == vr::k_unTrackedDeviceIndexInvalid || deviceId == id)
+			{
+				(*_statsPage)->poseHook[id].processing.addTo(processing);
+				(*_statsPage)->poseHook[id].steamvr.addTo(steamvr);
+			}
+		}
+	}
+
+	void VRInputEmulator::resetPoseHookHistograms(bool modal)
+	{
+		ipc::Request message(ipc::RequestType::Stats_ResetHistograms);
+		message.msg.ovr_GenericClientMessage.clientId = m_clientId;
+		auto result = _ipcRequestAsync(message, message.msg.ovr_GenericClientMessage.messageId, modal, "Error while resetting histograms: ");
+		if (modal)
+		{
+			result.get();
+		}
+	}
+
+	void VRInputEmulator::writeDriverTrace(const std::string& filename)
+	{
+		ipc::Request message(ipc::RequestType::Profiler_WriteTrace);
+		memset(&message.msg, 0, sizeof(message.msg));
+		message.msg.prof_WriteTrace.clientId = m_clientId;
+		if (filename.size() >= sizeof(message.msg.prof_WriteTrace.filename))
+		{
+			throw vrinputemulator_exception("Trace filename is too long.");
+		}
+		strncpy_s(message.msg.prof_WriteTrace.filename, filename.c_str(), sizeof(message.msg.prof_WriteTrace.filename) - 1);
+		_ipcRequestAsync(message, message.msg.prof_WriteTrace.messageId, true, "Error while writing driver trace: ").get();
+	}
+
+	void VRInputEmulator::subscribeDriverEvents(uint32_t eventMask, std::function<void(const DriverEvent&)> callback)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_eventCallbackMutex);
+			_eventCallback = eventMask ? std::move(callback) : nullptr;
+		}
+		ipc::Request message(ipc::RequestType::IPC_Subscribe);
+		message.msg.ipc_Subscribe.clientId = m_clientId;
+		message.msg.ipc_Subscribe.eventMask = eventMask;
+		_ipcRequestAsync(message, message.msg.ipc_Subscribe.messageId, true, "Error while subscribing to driver events: ").get();
+	}
+
+	AsyncReply<void> VRInputEmulator::pingAsync()
+	{
+		ipc::Request message(ipc::RequestType::IPC_Ping);
+		message.msg.ipc_Ping.clientId = m_clientId;
+		message.msg.ipc_Ping.nonce = message.timestamp;
+		return _ipcRequestAsync(message, message.msg.ipc_Ping.messageId, true, "Error while pinging server: ");
+	}
+
 
 	void VRInputEmulator::openvrVendorSpecificEvent(uint32_t deviceId, vr::EVREventType eventType, const vr::VREvent_Data_t& eventData, double timeOffset)
 	{
@@ -264,7 +690,7 @@ namespace vrinputemulator
 			message.msg.ovr_VendorSpecificEvent.eventType = eventType;
 			message.msg.ovr_VendorSpecificEvent.eventData = eventData;
 			message.msg.ovr_VendorSpecificEvent.timeOffset = timeOffset;
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+			_ipcSend(message);
 		}
 		else
 		{
@@ -274,404 +700,331 @@ namespace vrinputemulator
 
 	void VRInputEmulator::getDeviceInfo(uint32_t deviceId, DeviceInfo& info)
 	{
-		if (_ipcServerQueue)
+		info = getDeviceInfoAsync(deviceId).get();
+	}
+
+	AsyncReply<DeviceInfo> VRInputEmulator::getDeviceInfoAsync(uint32_t deviceId)
+	{
+		ipc::Request message(ipc::RequestType::DeviceManipulation_GetDeviceInfo);
+		memset(&message.msg, 0, sizeof(message.msg));
+		message.msg.ovr_GenericDeviceIdMessage.clientId = m_clientId;
+		message.msg.ovr_GenericDeviceIdMessage.deviceId = deviceId;
+		_ipcSendExpectingReply(message, message.msg.ovr_GenericDeviceIdMessage.messageId);
+		return AsyncReply<DeviceInfo>(this, message.msg.ovr_GenericDeviceIdMessage.messageId, "Error while getting device info: ");
+	}
+
+	void VRInputEmulator::_decodeReply(const ipc::Reply& resp, DeviceInfo& info)
+	{
+		info.deviceId = resp.msg.dm_deviceInfo.deviceId;
+		info.deviceClass = resp.msg.dm_deviceInfo.deviceClass;
+		info.deviceMode = resp.msg.dm_deviceInfo.deviceMode;
+		info.refDeviceId = resp.msg.dm_deviceInfo.refDeviceId;
+	}
+
+	void VRInputEmulator::getAllDeviceInfos(AllDeviceInfos& infos)
+	{
+		infos = getAllDeviceInfosAsync().get();
+	}
+
+	AsyncReply<AllDeviceInfos> VRInputEmulator::getAllDeviceInfosAsync()
+	{
+		ipc::Request message(ipc::RequestType::DeviceManipulation_GetAllDeviceInfos);
+		memset(&message.msg, 0, sizeof(message.msg));
+		message.msg.ovr_GenericClientMessage.clientId = m_clientId;
+		_ipcSendExpectingReply(message, message.msg.ovr_GenericClientMessage.messageId);
+		return AsyncReply<AllDeviceInfos>(this, message.msg.ovr_GenericClientMessage.messageId, "Error while getting device infos: ");
+	}
+
+	void VRInputEmulator::_decodeReply(const ipc::Reply& resp, AllDeviceInfos& infos)
+	{
+		infos.motionCompensationStatus = resp.msg.dm_allDeviceInfos.motionCompensationStatus;
+		infos.devices.clear();
+		for (uint32_t i = 0; i < resp.msg.dm_allDeviceInfos.deviceCount && i < vr::k_unMaxTrackedDeviceCount; ++i)
 		{
-			ipc::Request message(ipc::RequestType::DeviceManipulation_GetDeviceInfo);
-			memset(&message.msg, 0, sizeof(message.msg));
-			message.msg.ovr_GenericDeviceIdMessage.clientId = m_clientId;
-			message.msg.ovr_GenericDeviceIdMessage.deviceId = deviceId;
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.ovr_GenericDeviceIdMessage.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while getting device info: ";
-			if (resp.status == ipc::ReplyStatus::Ok)
-			{
-				info.deviceId = resp.msg.dm_deviceInfo.deviceId;
-				info.deviceClass = resp.msg.dm_deviceInfo.deviceClass;
-				info.deviceMode = resp.msg.dm_deviceInfo.deviceMode;
-			}
-			else if (resp.status == ipc::ReplyStatus::InvalidId)
-			{
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			}
-			else if (resp.status == ipc::ReplyStatus::NotFound)
-			{
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			}
-			else if (resp.status != ipc::ReplyStatus::Ok)
-			{
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
+			auto& d = resp.msg.dm_allDeviceInfos.devices[i];
+			infos.devices.push_back({ d.deviceId, d.deviceClass, d.deviceMode, d.refDeviceId });
 		}
-		else
+	}
+
+	void VRInputEmulator::setDeviceNormalMode(uint32_t deviceId, bool modal)
+	{
+		auto result = _setDeviceNormalMode(deviceId, modal);
+		if (modal)
 		{
-			throw vrinputemulator_connectionerror("No active connection.");
+			result.get();
 		}
 	}
 
-	void VRInputEmulator::setDeviceNormalMode(uint32_t deviceId, bool modal)
+	AsyncReply<void> VRInputEmulator::setDeviceNormalModeAsync(uint32_t deviceId)
 	{
-		if (_ipcServerQueue)
+		return _setDeviceNormalMode(deviceId, true);
+	}
+
+	AsyncReply<void> VRInputEmulator::_setDeviceNormalMode(uint32_t deviceId, bool wantReply)
+	{
+		ipc::Request message(ipc::RequestType::DeviceManipulation_DefaultMode);
+		memset(&message.msg, 0, sizeof(message.msg));
+		message.msg.ovr_GenericDeviceIdMessage.clientId = m_clientId;
+		message.msg.ovr_GenericDeviceIdMessage.deviceId = deviceId;
+		return _ipcRequestAsync(message, message.msg.ovr_GenericDeviceIdMessage.messageId, wantReply, "Error while setting normal mode: ");
+	}
+
+	void VRInputEmulator::setDeviceMotionCompensationMode(uint32_t deviceId, MotionCompensationVelAccMode velAccMode, bool modal)
+	{
+		auto result = _setDeviceMotionCompensationMode(deviceId, velAccMode, modal);
+		if (modal)
 		{
-			ipc::Request message(ipc::RequestType::DeviceManipulation_DefaultMode);
-			memset(&message.msg, 0, sizeof(message.msg));
-			message.msg.ovr_GenericDeviceIdMessage.clientId = m_clientId;
-			message.msg.ovr_GenericDeviceIdMessage.messageId = 0;
-			message.msg.ovr_GenericDeviceIdMessage.deviceId = deviceId;
-			if (modal)
-			{
-				uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-				std::promise<ipc::Reply> respPromise;
-				auto respFuture = respPromise.get_future();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-				}
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				auto resp = respFuture.get();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.erase(messageId);
-				}
-				std::stringstream ss;
-				ss << "Error while setting normal mode: ";
-				if (resp.status == ipc::ReplyStatus::InvalidId)
-				{
-					ss << "Invalid device id";
-					throw vrinputemulator_invalidid(ss.str());
-				}
-				else if (resp.status == ipc::ReplyStatus::NotFound)
-				{
-					ss << "Device not found";
-					throw vrinputemulator_notfound(ss.str());
-				}
-				else if (resp.status != ipc::ReplyStatus::Ok)
-				{
-					ss << "Error code " << (int)resp.status;
-					throw vrinputemulator_exception(ss.str());
-				}
-			}
-			else
-			{
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			}
+			result.get();
 		}
-		else
+	}
+
+	AsyncReply<void> VRInputEmulator::setDeviceMotionCompensationModeAsync(uint32_t deviceId, MotionCompensationVelAccMode velAccMode)
+	{
+		return _setDeviceMotionCompensationMode(deviceId, velAccMode, true);
+	}
+
+	AsyncReply<void> VRInputEmulator::_setDeviceMotionCompensationMode(uint32_t deviceId, MotionCompensationVelAccMode velAccMode, bool wantReply)
+	{
+		ipc::Request message(ipc::RequestType::DeviceManipulation_MotionCompensationMode);
+		memset(&message.msg, 0, sizeof(message.msg));
+		message.msg.dm_MotionCompensationMode.clientId = m_clientId;
+		message.msg.dm_MotionCompensationMode.deviceId = deviceId;
+		message.msg.dm_MotionCompensationMode.velAccCompensationMode = velAccMode;
+		auto result = _ipcRequestAsync(message, message.msg.dm_MotionCompensationMode.messageId, wantReply, "Error while setting motion compensation mode: ");
+		WRITELOG(INFO, "MC message created sending to driver" << std::endl);
+		return result;
+	}
+
+
+	void VRInputEmulator::applyMotionCompensation(uint32_t deviceId, const MotionCompensationSettings& settings, bool modal)
+	{
+		auto result = _applyMotionCompensation(deviceId, settings, modal);
+		if (modal)
 		{
-			throw vrinputemulator_connectionerror("No active connection.");
+			result.get();
 		}
 	}
 
-	void VRInputEmulator::setDeviceMotionCompensationMode(uint32_t deviceId, MotionCompensationVelAccMode velAccMode, bool modal)
+	AsyncReply<void> VRInputEmulator::applyMotionCompensationAsync(uint32_t deviceId, const MotionCompensationSettings& settings)
 	{
-		bool retval = false;
-		if (_ipcServerQueue)
+		return _applyMotionCompensation(deviceId, settings, true);
+	}
+
+	AsyncReply<void> VRInputEmulator::_applyMotionCompensation(uint32_t deviceId, const MotionCompensationSettings& settings, bool wantReply)
+	{
+		ipc::Request message(ipc::RequestType::DeviceManipulation_ApplyMotionCompensation);
+		memset(&message.msg, 0, sizeof(message.msg));
+		message.msg.dm_ApplyMotionCompensation.clientId = m_clientId;
+		message.msg.dm_ApplyMotionCompensation.deviceId = deviceId;
+		message.msg.dm_ApplyMotionCompensation.velAccCompensationMode = settings.velAccMode;
+		message.msg.dm_ApplyMotionCompensation.kalmanFilterProcessNoise = settings.kalmanProcessNoise;
+		message.msg.dm_ApplyMotionCompensation.kalmanFilterObservationNoise = settings.kalmanObservationNoise;
+		message.msg.dm_ApplyMotionCompensation.rotKalmanFilterProcessNoise = settings.rotKalmanProcessNoise;
+		message.msg.dm_ApplyMotionCompensation.rotKalmanFilterObservationNoise = settings.rotKalmanObservationNoise;
+		message.msg.dm_ApplyMotionCompensation.movingAverageWindow = settings.movingAverageWindow;
+		return _ipcRequestAsync(message, message.msg.dm_ApplyMotionCompensation.messageId, wantReply, "Error while applying motion compensation: ");
+	}
+
+
+	void VRInputEmulator::setMotionVelAccCompensationMode(MotionCompensationVelAccMode velAccMode, bool modal)
+	{
+		ipc::Request_DeviceManipulation_SetMotionCompensationProperties properties = {};
+		properties.velAccCompensationModeValid = true;
+		properties.velAccCompensationMode = velAccMode;
+		auto result = _setMotionCompensationProperties(properties, modal);
+		if (modal)
 		{
-			ipc::Request message(ipc::RequestType::DeviceManipulation_MotionCompensationMode);
-			memset(&message.msg, 0, sizeof(message.msg));
-			message.msg.dm_MotionCompensationMode.clientId = m_clientId;
-			message.msg.dm_MotionCompensationMode.messageId = 0;
-			message.msg.dm_MotionCompensationMode.deviceId = deviceId;
-			message.msg.dm_MotionCompensationMode.velAccCompensationMode = velAccMode;
-			if (modal)
-			{
-				uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-				message.msg.dm_MotionCompensationMode.messageId = messageId;
-				std::promise<ipc::Reply> respPromise;
-				auto respFuture = respPromise.get_future();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-				}
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				WRITELOG(INFO, "MC message created sending to driver" << std::endl);
-				auto resp = respFuture.get();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.erase(messageId);
-				}
-				std::stringstream ss;
-				ss << "Error while setting motion compensation mode: ";
-				if (resp.status == ipc::ReplyStatus::InvalidId)
-				{
-					ss << "Invalid device id";
-					throw vrinputemulator_invalidid(ss.str(), (int)resp.status);
-				}
-				else if (resp.status == ipc::ReplyStatus::NotFound)
-				{
-					ss << "Device not found";
-					throw vrinputemulator_notfound(ss.str(), (int)resp.status);
-				}
-				else if (resp.status != ipc::ReplyStatus::Ok)
-				{
-					ss << "Error code " << (int)resp.status;
-					throw vrinputemulator_exception(ss.str(), (int)resp.status);
-				}
-			}
-			else
-			{
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				WRITELOG(INFO, "MC message created sending to driver" << std::endl);
-			}
+			result.get();
 		}
-		else
+	}
+
+	AsyncReply<void> VRInputEmulator::setMotionVelAccCompensationModeAsync(MotionCompensationVelAccMode velAccMode)
+	{
+		ipc::Request_DeviceManipulation_SetMotionCompensationProperties properties = {};
+		properties.velAccCompensationModeValid = true;
+		properties.velAccCompensationMode = velAccMode;
+		return _setMotionCompensationProperties(properties, true);
+	}
+
+	void VRInputEmulator::setMotionCompensationKalmanProcessNoise(double variance, bool modal)
+	{
+		ipc::Request_DeviceManipulation_SetMotionCompensationProperties properties = {};
+		properties.kalmanFilterProcessNoiseValid = true;
+		properties.kalmanFilterProcessNoise = variance;
+		auto result = _setMotionCompensationProperties(properties, modal);
+		if (modal)
 		{
-			throw vrinputemulator_connectionerror("No active connection.");
+			result.get();
 		}
 	}
 
+	AsyncReply<void> VRInputEmulator::setMotionCompensationKalmanProcessNoiseAsync(double variance)
+	{
+		ipc::Request_DeviceManipulation_SetMotionCompensationProperties properties = {};
+		properties.kalmanFilterProcessNoiseValid = true;
+		properties.kalmanFilterProcessNoise = variance;
+		return _setMotionCompensationProperties(properties, true);
+	}
 
-	void VRInputEmulator::setMotionVelAccCompensationMode(MotionCompensationVelAccMode velAccMode, bool modal)
+	void VRInputEmulator::setMotionCompensationKalmanObservationNoise(double variance, bool modal)
 	{
-		if (_ipcServerQueue)
+		ipc::Request_DeviceManipulation_SetMotionCompensationProperties properties = {};
+		properties.kalmanFilterObservationNoiseValid = true;
+		properties.kalmanFilterObservationNoise = variance;
+		auto result = _setMotionCompensationProperties(properties, modal);
+		if (modal)
 		{
-			ipc::Request message(ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties);
-			memset(&message.msg, 0, sizeof(message.msg));
-			message.msg.dm_SetMotionCompensationProperties.clientId = m_clientId;
-			message.msg.dm_SetMotionCompensationProperties.messageId = 0;
-			message.msg.dm_SetMotionCompensationProperties.velAccCompensationModeValid = true;
-			message.msg.dm_SetMotionCompensationProperties.velAccCompensationMode = velAccMode;
-			message.msg.dm_SetMotionCompensationProperties.kalmanFilterProcessNoiseValid = false;
-			message.msg.dm_SetMotionCompensationProperties.kalmanFilterObservationNoiseValid = false;
-			if (modal)
-			{
-				uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-				message.msg.dm_SetMotionCompensationProperties.messageId = messageId;
-				std::promise<ipc::Reply> respPromise;
-				auto respFuture = respPromise.get_future();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-				}
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				WRITELOG(INFO, "MC message created sending to driver" << std::endl);
-				auto resp = respFuture.get();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.erase(messageId);
-				}
-				std::stringstream ss;
-				ss << "Error while setting motion compensation properties: ";
-				if (resp.status == ipc::ReplyStatus::InvalidId)
-				{
-					ss << "Invalid device id";
-					throw vrinputemulator_invalidid(ss.str(), (int)resp.status);
-				}
-				else if (resp.status == ipc::ReplyStatus::NotFound)
-				{
-					ss << "Device not found";
-					throw vrinputemulator_notfound(ss.str(), (int)resp.status);
-				}
-				else if (resp.status != ipc::ReplyStatus::Ok)
-				{
-					ss << "Error code " << (int)resp.status;
-					throw vrinputemulator_exception(ss.str(), (int)resp.status);
-				}
-			}
-			else
-			{
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				WRITELOG(INFO, "MC message created sending to driver" << std::endl);
-			}
+			result.get();
 		}
-		else
+	}
+
+	AsyncReply<void> VRInputEmulator::setMotionCompensationKalmanObservationNoiseAsync(double variance)
+	{
+		ipc::Request_DeviceManipulation_SetMotionCompensationProperties properties = {};
+		properties.kalmanFilterObservationNoiseValid = true;
+		properties.kalmanFilterObservationNoise = variance;
+		return _setMotionCompensationProperties(properties, true);
+	}
+
+	void VRInputEmulator::setMotionCompensationRotKalmanNoise(double processVariance, double observationVariance, bool modal)
+	{
+		ipc::Request_DeviceManipulation_SetMotionCompensationProperties properties = {};
+		properties.rotKalmanFilterNoiseValid = true;
+		properties.rotKalmanFilterProcessNoise = processVariance;
+		properties.rotKalmanFilterObservationNoise = observationVariance;
+		auto result = _setMotionCompensationProperties(properties, modal);
+		if (modal)
 		{
-			throw vrinputemulator_connectionerror("No active connection.");
+			result.get();
 		}
 	}
 
-	void VRInputEmulator::setMotionCompensationKalmanProcessNoise(double variance, bool modal)
+	AsyncReply<void> VRInputEmulator::setMotionCompensationRotKalmanNoiseAsync(double processVariance, double observationVariance)
 	{
-		if (_ipcServerQueue)
+		ipc::Request_DeviceManipulation_SetMotionCompensationProperties properties = {};
+		properties.rotKalmanFilterNoiseValid = true;
+		properties.rotKalmanFilterProcessNoise = processVariance;
+		properties.rotKalmanFilterObservationNoise = observationVariance;
+		return _setMotionCompensationProperties(properties, true);
+	}
+
+	void VRInputEmulator::setMotionCompensationMovingAverageWindow(unsigned window, bool modal)
+	{
+		ipc::Request_DeviceManipulation_SetMotionCompensationProperties properties = {};
+		properties.movingAverageWindowValid = true;
+		properties.movingAverageWindow = window;
+		auto result = _setMotionCompensationProperties(properties, modal);
+		if (modal)
 		{
-			ipc::Request message(ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties);
-			memset(&message.msg, 0, sizeof(message.msg));
-			message.msg.dm_SetMotionCompensationProperties.clientId = m_clientId;
-			message.msg.dm_SetMotionCompensationProperties.messageId = 0;
-			message.msg.dm_SetMotionCompensationProperties.velAccCompensationModeValid = false;
-			message.msg.dm_SetMotionCompensationProperties.kalmanFilterProcessNoiseValid = true;
-			message.msg.dm_SetMotionCompensationProperties.kalmanFilterProcessNoise = variance;
-			message.msg.dm_SetMotionCompensationProperties.kalmanFilterObservationNoiseValid = false;
-			if (modal)
-			{
-				uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-				message.msg.dm_SetMotionCompensationProperties.messageId = messageId;
-				std::promise<ipc::Reply> respPromise;
-				auto respFuture = respPromise.get_future();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-				}
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				WRITELOG(INFO, "MC message created sending to driver" << std::endl);
-				auto resp = respFuture.get();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.erase(messageId);
-				}
-				std::stringstream ss;
-				ss << "Error while setting motion compensation properties: ";
-				if (resp.status == ipc::ReplyStatus::InvalidId)
-				{
-					ss << "Invalid device id";
-					throw vrinputemulator_invalidid(ss.str(), (int)resp.status);
-				}
-				else if (resp.status == ipc::ReplyStatus::NotFound)
-				{
-					ss << "Device not found";
-					throw vrinputemulator_notfound(ss.str(), (int)resp.status);
-				}
-				else if (resp.status != ipc::ReplyStatus::Ok)
-				{
-					ss << "Error code " << (int)resp.status;
-					throw vrinputemulator_exception(ss.str(), (int)resp.status);
-				}
-			}
-			else
-			{
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				WRITELOG(INFO, "MC message created sending to driver" << std::endl);
-			}
+			result.get();
 		}
-		else
+	}
+
+	AsyncReply<void> VRInputEmulator::setMotionCompensationMovingAverageWindowAsync(unsigned window)
+	{
+		ipc::Request_DeviceManipulation_SetMotionCompensationProperties properties = {};
+		properties.movingAverageWindowValid = true;
+		properties.movingAverageWindow = window;
+		return _setMotionCompensationProperties(properties, true);
+	}
+
+	AsyncReply<void> VRInputEmulator::_setMotionCompensationProperties(const ipc::Request_DeviceManipulation_SetMotionCompensationProperties& properties, bool wantReply)
+	{
+		ipc::Request message(ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties);
+		memset(&message.msg, 0, sizeof(message.msg));
+		message.msg.dm_SetMotionCompensationProperties = properties;
+		message.msg.dm_SetMotionCompensationProperties.clientId = m_clientId;
+		auto result = _ipcRequestAsync(message, message.msg.dm_SetMotionCompensationProperties.messageId, wantReply, "Error while setting motion compensation properties: ");
+		WRITELOG(INFO, "MC message created sending to driver" << std::endl);
+		return result;
+	}
+
+
+	template<typename T>
+	AsyncReply<T>::AsyncReply(AsyncReply&& other) : _owner(other._owner), _messageId(other._messageId), _errorPrefix(other._errorPrefix)
+	{
+		other._owner = nullptr;
+	}
+
+	template<typename T>
+	AsyncReply<T>& AsyncReply<T>::operator=(AsyncReply&& other)
+	{
+		if (this != &other)
 		{
-			throw vrinputemulator_connectionerror("No active connection.");
+			_release();
+			_owner = other._owner;
+			_messageId = other._messageId;
+			_errorPrefix = other._errorPrefix;
+			other._owner = nullptr;
 		}
+		return *this;
 	}
 
-	void VRInputEmulator::setMotionCompensationKalmanObservationNoise(double variance, bool modal)
+	template<typename T>
+	AsyncReply<T>::~AsyncReply()
 	{
-		if (_ipcServerQueue)
+		_release();
+	}
+
+	template<typename T>
+	void AsyncReply<T>::_release()
+	{
+		if (_owner)
 		{
-			ipc::Request message(ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties);
-			memset(&message.msg, 0, sizeof(message.msg));
-			message.msg.dm_SetMotionCompensationProperties.clientId = m_clientId;
-			message.msg.dm_SetMotionCompensationProperties.messageId = 0;
-			message.msg.dm_SetMotionCompensationProperties.velAccCompensationModeValid = false;
-			message.msg.dm_SetMotionCompensationProperties.kalmanFilterProcessNoiseValid = false;
-			message.msg.dm_SetMotionCompensationProperties.kalmanFilterObservationNoiseValid = true;
-			message.msg.dm_SetMotionCompensationProperties.kalmanFilterObservationNoise = variance;
-			if (modal)
-			{
-				uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-				message.msg.dm_SetMotionCompensationProperties.messageId = messageId;
-				std::promise<ipc::Reply> respPromise;
-				auto respFuture = respPromise.get_future();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-				}
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				WRITELOG(INFO, "MC message created sending to driver" << std::endl);
-				auto resp = respFuture.get();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.erase(messageId);
-				}
-				std::stringstream ss;
-				ss << "Error while setting motion compensation properties: ";
-				if (resp.status == ipc::ReplyStatus::InvalidId)
-				{
-					ss << "Invalid device id";
-					throw vrinputemulator_invalidid(ss.str(), (int)resp.status);
-				}
-				else if (resp.status == ipc::ReplyStatus::NotFound)
-				{
-					ss << "Device not found";
-					throw vrinputemulator_notfound(ss.str(), (int)resp.status);
-				}
-				else if (resp.status != ipc::ReplyStatus::Ok)
-				{
-					ss << "Error code " << (int)resp.status;
-					throw vrinputemulator_exception(ss.str(), (int)resp.status);
-				}
-			}
-			else
-			{
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				WRITELOG(INFO, "MC message created sending to driver" << std::endl);
-			}
+			_owner->_ipcAbandonReply(_messageId);
+			_owner = nullptr;
 		}
-		else
+	}
+
+	template<typename T>
+	bool AsyncReply<T>::ready() const
+	{
+		return _owner && _owner->_ipcReplyArrived(_messageId);
+	}
+
+	template<typename T>
+	void AsyncReply<T>::wait() const
+	{
+		if (_owner)
 		{
-			throw vrinputemulator_connectionerror("No active connection.");
+			_owner->_ipcWaitReply(_messageId);
 		}
 	}
 
-	void VRInputEmulator::setMotionCompensationMovingAverageWindow(unsigned window, bool modal)
+	template<typename T>
+	T AsyncReply<T>::get()
 	{
-		if (_ipcServerQueue)
+		if (!_owner)
 		{
-			ipc::Request message(ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties);
-			memset(&message.msg, 0, sizeof(message.msg));
-			message.msg.dm_SetMotionCompensationProperties.clientId = m_clientId;
-			message.msg.dm_SetMotionCompensationProperties.messageId = 0;
-			message.msg.dm_SetMotionCompensationProperties.velAccCompensationModeValid = false;
-			message.msg.dm_SetMotionCompensationProperties.kalmanFilterProcessNoiseValid = false;
-			message.msg.dm_SetMotionCompensationProperties.kalmanFilterObservationNoiseValid = false;
-			message.msg.dm_SetMotionCompensationProperties.movingAverageWindowValid = true;
-			message.msg.dm_SetMotionCompensationProperties.movingAverageWindow = window;
-			if (modal)
-			{
-				uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-				message.msg.dm_SetMotionCompensationProperties.messageId = messageId;
-				std::promise<ipc::Reply> respPromise;
-				auto respFuture = respPromise.get_future();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-				}
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				WRITELOG(INFO, "MC message created sending to driver" << std::endl);
-				auto resp = respFuture.get();
-				{
-					std::lock_guard<std::recursive_mutex> lock(_mutex);
-					_ipcPromiseMap.erase(messageId);
-				}
-				std::stringstream ss;
-				ss << "Error while setting motion compensation properties: ";
-				if (resp.status == ipc::ReplyStatus::InvalidId)
-				{
-					ss << "Invalid device id";
-					throw vrinputemulator_invalidid(ss.str(), (int)resp.status);
-				}
-				else if (resp.status == ipc::ReplyStatus::NotFound)
-				{
-					ss << "Device not found";
-					throw vrinputemulator_notfound(ss.str(), (int)resp.status);
-				}
-				else if (resp.status != ipc::ReplyStatus::Ok)
-				{
-					ss << "Error code " << (int)resp.status;
-					throw vrinputemulator_exception(ss.str(), (int)resp.status);
-				}
-			}
-			else
-			{
-				_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-				WRITELOG(INFO, "MC message created sending to driver" << std::endl);
-			}
+			throw vrinputemulator_exception("No reply to wait for.");
 		}
-		else
+		ipc::Reply resp;
+		auto owner = _owner;
+		_owner = nullptr;
+		owner->_ipcTakeReply(_messageId, resp);
+		VRInputEmulator::_checkReplyStatus(resp, _errorPrefix);
+		T result;
+		VRInputEmulator::_decodeReply(resp, result);
+		return result;
+	}
+
+	template<>
+	void AsyncReply<void>::get()
+	{
+		if (!_owner)
 		{
-			throw vrinputemulator_connectionerror("No active connection.");
+			throw vrinputemulator_exception("No reply to wait for.");
 		}
+		ipc::Reply resp;
+		auto owner = _owner;
+		_owner = nullptr;
+		owner->_ipcTakeReply(_messageId, resp);
+		VRInputEmulator::_checkReplyStatus(resp, _errorPrefix);
 	}
 
+	template class AsyncReply<void>;
+	template class AsyncReply<DeviceInfo>;
+	template class AsyncReply<AllDeviceInfos>;
+
 
 } // end namespace vrinputemulator
\ No newline at end of file
@@ -0,0 +1,12 @@
+// Compile check: client code gets vr::DriverPose_t from vrinputemulator.h and must be able to read pose recordings as well,
+// so pose_recording.h must not pull in a second definition from openvr_driver.h.
+
+#include <vrinputemulator.h>
+#include <pose_recording.h>
+
+
+int main()
+{
+	static_assert(sizeof(vrinputemulator::PoseRecord) == 2 * sizeof(vr::DriverPose_t) + 16, "Unexpected pose record layout");
+	return 0;
+}
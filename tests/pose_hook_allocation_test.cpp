@@ -0,0 +1,157 @@
+// Replays a pose recording (see pose_recording.h) through ServerDriver::hooksTrackedDevicePoseUpdated once for every motion
+// compensation vel/acc mode and fails when a pose update allocates memory.
+// Linked against the driver built with VRINPUTEMULATOR_ALLOCATION_TRACKING (see AllocationTracker.h).
+//
+// Usage: pose_hook_allocation_test [--ref <id>] <recording>
+//        pose_hook_allocation_test [--ref <id>] --synthesize <file>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <openvr_driver.h>
+#include <pose_recording.h>
+#include "ServerDriverStub.h"
+#include "SyntheticPoseRecording.h"
+
+using namespace vrinputemulator;
+using namespace vrinputemulator::driver;
+
+#ifndef VRINPUTEMULATOR_ALLOCATION_TRACKING
+	#error "Needs the driver built with VRINPUTEMULATOR_ALLOCATION_TRACKING"
+#endif
+
+
+static const struct
+{
+	MotionCompensationVelAccMode mode;
+	const char* name;
+} velAccModes[] = {
+	{ MotionCompensationVelAccMode::Disabled, "Disabled" },
+	{ MotionCompensationVelAccMode::SetZero, "SetZero" },
+	{ MotionCompensationVelAccMode::SubstractMotionRef, "SubstractMotionRef" },
+	{ MotionCompensationVelAccMode::LinearApproximation, "LinearApproximation" },
+	{ MotionCompensationVelAccMode::KalmanFilter, "KalmanFilter" },
+};
+
+static const int64_t runFrameInterval = 11000000; // nanoseconds, SteamVR calls RunFrame at about 90 Hz
+
+
+int main(int argc, char* argv[])
+{
+	std::string recordingFile;
+	std::string synthesizeFile;
+	uint32_t refDeviceId = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--ref" && hasValue)
+		{
+			refDeviceId = (uint32_t)std::atoi(argv[++i]);
+		}
+		else if (arg == "--synthesize" && hasValue)
+		{
+			synthesizeFile = argv[++i];
+		}
+		else if (arg[0] != '-' && recordingFile.empty())
+		{
+			recordingFile = arg;
+		}
+		else
+		{
+			std::fprintf(stderr, "Usage: %s [--ref <id>] <recording> | --synthesize <file>\n", argv[0]);
+			return 2;
+		}
+	}
+	el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Enabled, "false");
+
+	PoseRecordingReader recording;
+	try
+	{
+		if (!synthesizeFile.empty())
+		{
+			SyntheticPoseRecordingParams synthetic;
+			synthetic.seconds = 5.0;
+			writeSyntheticPoseRecording(synthesizeFile, synthetic);
+			recordingFile = synthesizeFile;
+		}
+		if (recordingFile.empty())
+		{
+			std::fprintf(stderr, "No recording given\n");
+			return 2;
+		}
+		recording.open(recordingFile);
+	}
+	catch (std::exception& e)
+	{
+		std::fprintf(stderr, "Could not open pose recording: %s\n", e.what());
+		return 2;
+	}
+
+	ServerDriver driver;
+	DeviceManipulationHandle* handles[vr::k_unMaxTrackedDeviceCount] = {};
+	for (auto& rec : recording)
+	{
+		if (rec.deviceId < vr::k_unMaxTrackedDeviceCount && !handles[rec.deviceId])
+		{
+			auto deviceClass = rec.deviceId == vr::k_unTrackedDeviceIndex_Hmd ? vr::TrackedDeviceClass_HMD : vr::TrackedDeviceClass_Controller;
+			handles[rec.deviceId] = stub::addDevice(driver, rec.deviceId, deviceClass, ("device" + std::to_string(rec.deviceId)).c_str());
+		}
+	}
+	if (refDeviceId >= vr::k_unMaxTrackedDeviceCount || !handles[refDeviceId])
+	{
+		std::fprintf(stderr, "Motion reference device %u does not appear in the recording\n", refDeviceId);
+		return 2;
+	}
+
+	int failures = 0;
+	for (auto& m : velAccModes)
+	{
+		auto refHandle = handles[refDeviceId];
+		refHandle->setDefaultMode();
+		driver.motionCompensation().applyMotionCompensationConfig(m.mode, 0.1, 0.1, 10.0, 0.5, 3);
+		refHandle->setMotionCompensationMode();
+
+		size_t allocatingPoses = 0;
+		uint64_t allocations = 0;
+		auto nextRunFrame = recording[0].timestamp;
+		for (size_t i = 0; i < recording.size(); i++)
+		{
+			auto& rec = recording[i];
+			if (rec.deviceId >= vr::k_unMaxTrackedDeviceCount)
+			{
+				continue;
+			}
+			if (rec.timestamp >= nextRunFrame)
+			{
+				driver.RunFrame(); // runs on its own thread in SteamVR, allocations there are allowed
+				nextRunFrame += runFrameInterval;
+			}
+			uint32_t deviceId = rec.deviceId;
+			uint32_t poseStructSize = sizeof(vr::DriverPose_t);
+			auto pose = rec.rawPose;
+			auto before = AllocationTracker::threadAllocationCount();
+			driver.hooksTrackedDevicePoseUpdated(nullptr, 5, deviceId, pose, poseStructSize);
+			auto count = AllocationTracker::threadAllocationCount() - before;
+			if (count > 0)
+			{
+				if (allocatingPoses == 0)
+				{
+					std::fprintf(stderr, "%s: pose %zu (device %u) allocated memory %llu times\n", m.name, i, deviceId, (unsigned long long)count);
+				}
+				allocatingPoses++;
+				allocations += count;
+			}
+		}
+		if (allocatingPoses > 0)
+		{
+			std::printf("%-24s FAILED: %zu of %zu poses allocated memory, %llu allocations\n", m.name, allocatingPoses, recording.size(), (unsigned long long)allocations);
+			failures++;
+		}
+		else
+		{
+			std::printf("%-24s ok: %zu poses, no allocations\n", m.name, recording.size());
+		}
+	}
+	return failures == 0 ? 0 : 1;
+}
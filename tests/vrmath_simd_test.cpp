@@ -0,0 +1,159 @@
+// Checks the SIMD kernels of openvr_math.h against plain scalar implementations.
+// Built once per code path (see CMakeLists.txt), VRMATH_TEST_EXPECT_AVX / VRMATH_TEST_EXPECT_SSE2 make sure the build
+// actually picked the path it is meant to test.
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <openvr_driver.h>
+#include <openvr_math.h>
+
+#if defined(VRMATH_TEST_EXPECT_AVX) && !defined(VRMATH_AVX)
+	#error "AVX build does not use the AVX kernels"
+#endif
+#if defined(VRMATH_TEST_EXPECT_SSE2) && (!defined(VRMATH_SSE2) || defined(VRMATH_AVX))
+	#error "SSE2 build does not use the SSE2 kernels"
+#endif
+#if defined(VRMATH_NO_SIMD) && (defined(VRMATH_SSE2) || defined(VRMATH_AVX))
+	#error "Scalar build uses SIMD kernels"
+#endif
+
+#if defined(VRMATH_AVX)
+static const char* codePath = "AVX";
+#elif defined(VRMATH_SSE2)
+static const char* codePath = "SSE2";
+#else
+static const char* codePath = "scalar";
+#endif
+
+static const double tolerance = 1e-12;
+static int failures = 0;
+
+
+static vr::HmdQuaternion_t refMul(const vr::HmdQuaternion_t& a, const vr::HmdQuaternion_t& b)
+{
+	return {
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+		a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y + a.y * b.w + a.z * b.x - a.x * b.z,
+		a.w * b.z + a.z * b.w + a.x * b.y - a.y * b.x
+	};
+}
+
+static vr::HmdVector3d_t refRotate(const vr::HmdQuaternion_t& q, const vr::HmdVector3d_t& v, bool reverse)
+{
+	vr::HmdQuaternion_t qc = { q.w, -q.x, -q.y, -q.z };
+	vr::HmdQuaternion_t p = { 0.0, v.v[0], v.v[1], v.v[2] };
+	auto r = reverse ? refMul(refMul(qc, p), q) : refMul(refMul(q, p), qc);
+	return { r.x, r.y, r.z };
+}
+
+static void check(const char* what, size_t index, const double* actual, const double* expected, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!(std::fabs(actual[i] - expected[i]) <= tolerance * (1.0 + std::fabs(expected[i]))))
+		{
+			if (failures++ < 20)
+			{
+				std::printf("%s[%zu]: component %zu is %.17g, expected %.17g\n", what, index, i, actual[i], expected[i]);
+			}
+		}
+	}
+}
+
+
+int main()
+{
+#if defined(VRMATH_AVX) && defined(__GNUC__)
+	if (!__builtin_cpu_supports("avx"))
+	{
+		std::printf("AVX: not supported by this cpu, skipped\n");
+		return 77; // SKIP_RETURN_CODE, see CMakeLists.txt
+	}
+#endif
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<double> dist(-2.0, 2.0);
+	const size_t count = 1000;
+
+	// quaternion product, including not normalized quaternions
+	for (size_t i = 0; i < count; i++)
+	{
+		vr::HmdQuaternion_t a = { dist(rng), dist(rng), dist(rng), dist(rng) };
+		vr::HmdQuaternion_t b = { dist(rng), dist(rng), dist(rng), dist(rng) };
+		auto actual = a * b;
+		auto expected = refMul(a, b);
+		check("quaternion product", i, &actual.w, &expected.w, 4);
+	}
+
+	// batched rotation, every batch size up to 9 to cover any remainder handling, both directions, in place and out of place
+	for (size_t batch = 1; batch <= 9; batch++)
+	{
+		for (int reverse = 0; reverse < 2; reverse++)
+		{
+			for (size_t n = 0; n < count / 10; n++)
+			{
+				auto q = vrmath::quaternionFromYawPitchRoll(dist(rng), dist(rng), dist(rng));
+				std::vector<vr::HmdVector3d_t> in(batch), out(batch + 1), inPlace(batch + 1);
+				for (size_t i = 0; i < batch; i++)
+				{
+					in[i] = { dist(rng), dist(rng), dist(rng) };
+					inPlace[i] = in[i];
+				}
+				const vr::HmdVector3d_t guard = { 123.0, 456.0, 789.0 };
+				out[batch] = guard;
+				inPlace[batch] = guard;
+				vrmath::quaternionRotateVectors(q, in.data(), out.data(), batch, reverse != 0);
+				vrmath::quaternionRotateVectors(q, inPlace.data(), inPlace.data(), batch, reverse != 0);
+				for (size_t i = 0; i < batch; i++)
+				{
+					auto expected = refRotate(q, in[i], reverse != 0);
+					auto single = vrmath::quaternionRotateVector(q, in[i], reverse != 0);
+					check("quaternionRotateVectors", i, out[i].v, expected.v, 3);
+					check("quaternionRotateVectors (in place)", i, inPlace[i].v, expected.v, 3);
+					check("quaternionRotateVector", i, single.v, expected.v, 3);
+				}
+				check("quaternionRotateVectors guard", batch, out[batch].v, guard.v, 3);
+				check("quaternionRotateVectors guard (in place)", batch, inPlace[batch].v, guard.v, 3);
+			}
+		}
+	}
+
+	// batched matrix vector product with an arbitrary (not orthogonal) matrix
+	for (size_t n = 0; n < count / 10; n++)
+	{
+		vrmath::Matrix33d m;
+		for (auto& row : m.m)
+		{
+			for (auto& e : row)
+			{
+				e = dist(rng);
+			}
+		}
+		const size_t batch = 7;
+		vr::HmdVector3d_t in[batch], out[batch];
+		for (auto& v : in)
+		{
+			v = { dist(rng), dist(rng), dist(rng) };
+		}
+		vrmath::matMul33(m, in, out, batch);
+		for (size_t i = 0; i < batch; i++)
+		{
+			double expected[3];
+			for (int r = 0; r < 3; r++)
+			{
+				expected[r] = m.m[r][0] * in[i].v[0] + m.m[r][1] * in[i].v[1] + m.m[r][2] * in[i].v[2];
+			}
+			check("matMul33 (batched)", i, out[i].v, expected, 3);
+		}
+	}
+
+	if (failures)
+	{
+		std::printf("%s: %d mismatches\n", codePath, failures);
+		return 1;
+	}
+	std::printf("%s: all kernels match the scalar reference\n", codePath);
+	return 0;
+}